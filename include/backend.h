@@ -0,0 +1,64 @@
+/**
+ * @file backend.h
+ * @brief Declares the execution backend interface and the available backends.
+ * @version 0.1
+ *
+ * Everything the shell does to create processes, wait for them and set up their file descriptors goes through the active backend. The
+ * Linux backend uses the real system calls. The simulated backend models processes, pipes and files in memory, with a virtual clock,
+ * so that the pipeline, job-control and admission control logic can be benchmarked at scale without creating a single process.
+ *
+ */
+
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include "command.h"
+
+#include <signal.h>
+#include <sys/types.h>
+
+// Environment variable selecting the backend at startup
+#define BACKEND_ENV "MODSHELL_BACKEND"
+
+// Simulated backend configuration, read from the environment when the backend is selected
+#define SIM_RUNTIME_ENV   "MODSHELL_SIM_RUNTIME_US"  /**< Runtime of a simulated process, in microseconds (default 1000) */
+#define SIM_EXIT_ENV      "MODSHELL_SIM_EXIT"        /**< Exit status of a simulated process (default 0) */
+#define SIM_OUTPUT_ENV    "MODSHELL_SIM_OUTPUT"      /**< Output of a simulated process (default none) */
+#define SIM_PIDS_MAX_ENV  "MODSHELL_SIM_PIDS_MAX"    /**< Number of live processes after which spawns fail with EAGAIN (default no limit) */
+
+// Simulated pids and file descriptors live in ranges that can't collide with real ones
+#define SIM_PID_BASE  (1 << 23)
+#define SIM_FD_BASE   (1 << 20)
+
+/**
+ * @brief Operations an execution backend provides.
+ *
+ * Mirrors the system calls the shell needs, with the same return conventions (-1 and errno on failure).
+ */
+typedef struct ExecBackend {
+    const char* name;                                        /**< Name used to select the backend */
+    void (*init)();                                          /**< Called when the backend becomes active, may be NULL */
+    pid_t (*spawn)(SimpleCommand* simpleCommand);            /**< Starts the command, returns its pid. Never returns in a real child */
+    pid_t (*wait)(pid_t pid, int* status, int options);      /**< Same contract as waitpid() */
+    int (*alive)(pid_t pid);                                 /**< Whether a process is still running, without reaping it */
+    void (*waitChild)(const sigset_t* mask);                 /**< Blocks until a child may have exited, called with SIGCHLD blocked */
+    int (*pipe)(int fds[2]);                                 /**< Same contract as pipe() */
+    int (*open)(const char* path, int flags, mode_t mode);   /**< Same contract as open() */
+    int (*close)(int fd);                                    /**< Same contract as close() */
+    void (*sleep)(long us);                                  /**< Sleeps, used by the spawn backoff */
+    void (*printStats)();                                    /**< Prints backend specific counters, may be NULL */
+} ExecBackend;
+
+extern const ExecBackend* execBackend;  ///< The active backend
+extern const ExecBackend linuxBackend;  ///< Backend using the real system calls
+extern const ExecBackend simBackend;    ///< Simulated in-memory backend
+
+/**
+ * @brief Makes a backend the active one.
+ *
+ * @param name "linux" or "sim".
+ * @return int 0 on success, -1 if there is no backend with that name.
+ */
+int selectBackend(const char* name);
+
+#endif // BACKEND_H
@@ -27,6 +27,7 @@ typedef struct SimpleCommand {
     int outputFD;      //< Output file descriptor (default is 1 for stdout)
     int stderrFD;      //< Error file descriptor (default is 2 for stderr)
     int pid;           //< Process ID of the child process, default is -1
+    int pgid;          //< Process group to run in: -1 for the shell's (default), 0 for a new group led by this process, otherwise the group to join
     char* inputFile;   //< Optional input file for redirection
     char* outputFile;  //< Optional output file for redirection
     int noWait;        //< Flag indicating whether to wait for the command to finish (0: wait, 1: no wait)
@@ -176,6 +177,16 @@ int executeCommandChain(CommandChain* chain);
  */
 int executeCommand(Command* command);
 
+/**
+ * @brief Closes the redirected file descriptors of a Command's SimpleCommands.
+ * 
+ * Closes the input, output and error descriptors of every SimpleCommand starting at the given index, and resets them to the standard ones. Used when a pipeline is abandoned midway so the stages already running are not left waiting on a pipe.
+ * 
+ * @param command Pointer to the Command whose descriptors will be closed
+ * @param from Index of the first SimpleCommand to close
+ */
+void closeCommandFDs(Command* command, int from);
+
 // ------------------------- Debug --------------------------------
 
 /**
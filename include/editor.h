@@ -0,0 +1,44 @@
+/**
+ * @file editor.h
+ * @brief Declares the interactive line editor with inline syntax feedback.
+ * @version 0.1
+ *
+ * When stdin and stdout are terminals, the prompt is read by a small raw-mode line editor instead of fgets(). On every keystroke the
+ * incremental syntax checker updates the tokens around the edit, tokens with a problem are underlined in red, and a short description of
+ * the problem next to the cursor is shown after the line. Only the part of the line from the edit onwards is redrawn.
+ *
+ */
+
+#ifndef EDITOR_H
+#define EDITOR_H
+
+#include "utils.h"
+
+/**
+ * @brief Decides whether interactive input goes through the line editor.
+ *
+ * The editor is only used when stdin and stdout are terminals and TERM is set to something other than "dumb".
+ *
+ * @param enabled Whether the editor is wanted at all, 0 with --noediting.
+ */
+void initLineEditor(int enabled);
+
+/**
+ * @brief Checks whether interactive input goes through the line editor.
+ *
+ * @return int 1 if it does, 0 if input is read with fgets().
+ */
+int lineEditorActive();
+
+/**
+ * @brief Prints the prompt and reads a line with the line editor.
+ *
+ * Supports insertion anywhere in the line, Backspace, Delete, the arrow keys, Home/End, Ctrl-A/E/B/F/K/U, Ctrl-C to discard the line and
+ * Ctrl-D on an empty line for end of file.
+ *
+ * @param prompt The prompt.
+ * @return char* The line, without its newline, to be freed by the caller. NULL at end of file.
+ */
+char* editLine(const char* prompt);
+
+#endif // EDITOR_H
@@ -0,0 +1,73 @@
+/**
+ * @file footprint.h
+ * @brief Declares the low-memory mode for shells that spend most of their life idle at the prompt.
+ * @version 0.1
+ *
+ * In low-memory mode the shell trims the malloc heap after every command, compacts its history into a read-only mapping, and after
+ * an idle timeout at the prompt releases the caches it can rebuild on demand. The memstat builtin reports the shell's RSS and PSS.
+ *
+ */
+
+#ifndef FOOTPRINT_H
+#define FOOTPRINT_H
+
+#include "utils.h"
+
+// Default time at the prompt after which the caches are released
+#define FOOTPRINT_DEFAULT_IDLE_MS 30000
+
+// Environment variable overriding the idle timeout, in seconds
+#define FOOTPRINT_IDLE_ENV "MODSHELL_IDLE_TIMEOUT"
+
+// File holding the memory usage summary of the shell
+#define FOOTPRINT_SMAPS_ROLLUP "/proc/self/smaps_rollup"
+
+// Structure holding the low-memory mode settings
+typedef struct FootprintConfig {
+    int enabled;           /**< Whether the low-memory mode is on */
+    int idleTimeoutMs;     /**< Time at the prompt after which the caches are released */
+    int released;          /**< Whether the caches were released since the last command */
+    unsigned long idleReleases;  /**< Number of times the caches were released for idleness */
+} FootprintConfig;
+
+extern FootprintConfig footprint;  ///< Active low-memory mode settings
+
+/**
+ * @brief Initializes the low-memory mode.
+ *
+ * When enabled, reads the idle timeout from MODSHELL_IDLE_TIMEOUT and makes stdin unbuffered, which both drops its buffer and lets
+ * the idle wait rely on poll().
+ *
+ * @param enabled Whether the low-memory mode is on.
+ */
+void initFootprint(int enabled);
+
+/**
+ * @brief Waits for interactive input, releasing the caches if the shell stays idle past the timeout.
+ *
+ * Returns immediately when the low-memory mode is off.
+ */
+void waitForInput();
+
+/**
+ * @brief Releases the memory the shell can do without between commands.
+ *
+ * Compacts the history once enough nodes have piled up and trims the malloc heap. Does nothing when the low-memory mode is off.
+ */
+void trimAfterCommand();
+
+/**
+ * @brief Releases every cache that can be rebuilt on demand.
+ *
+ * Compacts the history, frees the log writer's ring and the PATH cache, and trims the malloc heap.
+ */
+void releaseIdleMemory();
+
+/**
+ * @brief Prints the shell's resident (RSS) and proportional (PSS) memory usage and the history footprint to stdout.
+ *
+ * @return int Returns 0 on success, -1 if the memory usage can't be read.
+ */
+int printMemoryUsage();
+
+#endif // FOOTPRINT_H
@@ -0,0 +1,73 @@
+/**
+ * @file jobs.h
+ * @brief Declares the background job table and the live job resource monitor.
+ * @version 0.1
+ *
+ * Every command started with `&` becomes a job running in its own process group. Jobs are tracked with pidfds where the kernel supports
+ * them. The monitor samples /proc/<pid>/stat and /proc/<pid>/io for every process in a job's process group, on a timerfd cadence, only
+ * while the view is open.
+ *
+ */
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "command.h"
+
+#include <sys/types.h>
+
+// Default sampling interval of the monitor, in milliseconds
+#define JOBTOP_DEFAULT_INTERVAL_MS 1000
+
+// Sampling interval used by `jobs -v` to compute CPU usage
+#define JOBS_VERBOSE_INTERVAL_MS 200
+
+// Number of pidfds the job table keeps open, processes beyond that are tracked by probing their pid
+#define JOBS_MAX_PIDFDS 64
+
+// Structure to represent a background job
+typedef struct Job {
+    int id;               /**< Job number, as shown by `jobs` */
+    pid_t pgid;           /**< Process group of the job, the pid of its first process */
+    pid_t* pids;          /**< Pids of the job's pipeline stages */
+    int* pidfds;          /**< pidfds of the stages, -1 where pidfd_open is unavailable */
+    int nPids;            /**< Number of pipeline stages */
+    char* commandLine;    /**< Reconstructed command line, for display */
+} Job;
+
+/**
+ * @brief Adds a background command that was just started to the job table.
+ *
+ * Jobs that have finished are forgotten first, closing their pidfds.
+ *
+ * @param command The command, whose simple commands hold the pids of the started processes.
+ * @return int The job number, or -1 on failure.
+ */
+int addJob(Command* command);
+
+/**
+ * @brief Prints the job table, then forgets the jobs that have finished.
+ *
+ * @param verbose Whether to sample and print the resource usage of every process in each job's process group.
+ * @return int 0 on success, -1 on failure.
+ */
+int printJobs(int verbose);
+
+/**
+ * @brief Runs the live job resource monitor.
+ *
+ * Redraws the resource usage of every job on each timer tick until Enter is pressed on a terminal, the requested number of samples has
+ * been shown, or every job has finished.
+ *
+ * @param intervalMs Sampling interval in milliseconds.
+ * @param count Number of samples to show, 0 for no limit.
+ * @return int 0 on success, -1 on failure.
+ */
+int runJobTop(int intervalMs, int count);
+
+/**
+ * @brief Frees the job table.
+ */
+void cleanUpJobs();
+
+#endif // JOBS_H
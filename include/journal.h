@@ -0,0 +1,69 @@
+/**
+ * @file journal.h
+ * @brief Declares the script execution journal used to resume scripts after a failure.
+ * @version 0.1
+ *
+ * In journal mode, the script loop appends one record per completed top-level command: its line number, a hash of the line and its
+ * exit status. A resumed run skips the commands that succeeded in a previous run, as long as their line is unchanged.
+ *
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "utils.h"
+
+#include <stdint.h>
+
+// Suffix of the default journal path, appended to the script path
+#define JOURNAL_SUFFIX ".journal"
+
+// Structure to represent an open journal
+typedef struct Journal {
+    int fd;                 /**< Journal file, opened for appending, -1 when journaling is off */
+    uint64_t* succeeded;    /**< Hash of the line that last succeeded at each line number, 0 if none */
+    int nLines;             /**< Number of entries in succeeded */
+    unsigned long skipped;  /**< Commands skipped in this run */
+} Journal;
+
+/**
+ * @brief Opens the journal of a script run.
+ *
+ * A fresh run truncates the journal. A resumed run first loads the commands that succeeded in previous runs, then appends to the
+ * journal so that a run failing again can be resumed again.
+ *
+ * @param journal The journal to initialize.
+ * @param path Path to the journal file.
+ * @param resume Whether previous successes should be loaded and skipped.
+ * @return int 0 on success, -1 if the journal can't be opened.
+ */
+int openJournal(Journal* journal, const char* path, int resume);
+
+/**
+ * @brief Checks whether a script line succeeded in a previous run and can be skipped.
+ *
+ * @param journal The journal.
+ * @param lineNumber The line number in the script.
+ * @param input The line as read from the script.
+ * @return int 1 if the line can be skipped, 0 otherwise.
+ */
+int journalShouldSkip(Journal* journal, int lineNumber, const char* input);
+
+/**
+ * @brief Records a completed top-level command.
+ *
+ * @param journal The journal.
+ * @param lineNumber The line number in the script.
+ * @param input The line as read from the script.
+ * @param status The exit status of the command.
+ */
+void journalRecord(Journal* journal, int lineNumber, const char* input, int status);
+
+/**
+ * @brief Closes the journal and frees its table.
+ *
+ * @param journal The journal.
+ */
+void closeJournal(Journal* journal);
+
+#endif // JOURNAL_H
@@ -1,7 +1,11 @@
 /**
  * @file log.h
  * @brief Provides macros and functions for logging messages with different severity levels and optional annotations.
- * @version 0.1
+ * @version 0.2
+ *
+ * Diagnostics (errors and debug messages) are filtered by a runtime log level and handed to an asynchronous writer thread, which
+ * decorates them and writes them to the configured sink (stderr, a file, or a syslog-compatible local socket). Regular output is
+ * always printed synchronously to stdout.
  */
 
 #ifndef LOG_H
@@ -18,25 +22,35 @@
 #define LOG_CYAN    "\033[1;36m" /**< Cyan color for debug messages */
 #define LOG_WHITE   "\033[1;37m" /**< White color for general messages */
 
-// Log levels and their respective display modes
-#define LOG_ERR     0  /**< Log level for critical errors, always printed */
-#define LOG_DBG     1  /**< Log level for debug messages, printed only in debug mode */
-#define LOG_PRI     2  /**< Log level for regular messages, always printed without special annotations */
+// Log types and their respective display modes
+#define LOG_ERR     0  /**< Log type for critical errors, printed unless logging is turned off */
+#define LOG_DBG     1  /**< Log type for debug messages, printed only at the debug log level */
+#define LOG_PRI     2  /**< Log type for regular messages, always printed to stdout without special annotations */
+
+// Runtime log levels. A diagnostic is written when its type is less than or equal to the current level.
+#define LOG_LEVEL_OFF    -1  /**< No diagnostics at all */
+#define LOG_LEVEL_ERROR  0   /**< Errors only */
+#define LOG_LEVEL_DEBUG  1   /**< Errors and debug messages, with annotations */
+
+// Log sinks
+#define LOG_SINK_STDERR  0  /**< The shell's original stderr */
+#define LOG_SINK_FILE    1  /**< A file, opened in append mode */
+#define LOG_SINK_SYSLOG  2  /**< A syslog-compatible local datagram socket */
 
 // Default colors for different log types
 #define LOG_COLOR_ERR   LOG_RED    /**< Default color for error messages */
 #define LOG_COLOR_DBG   LOG_CYAN  /**< Default color for debug messages */
 #define LOG_COLOR_PRI   LOG_WHITE /**< Default color for regular messages */
 
-// Debug mode configuration
+// Debug mode configuration. Debug builds start at the debug level, release builds at the error level.
 #ifdef DEBUG
-#define ANNOTATIONS 1      /**< Set to 1 to enable annotations in debug mode (file, function, line info) */
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_DEBUG
 #else
 #define DEBUG 0
-#define ANNOTATIONS 0
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_ERROR
 #endif
 
-// Configuration for annotations
+// Configuration for annotations, added to diagnostics at the debug level
 #define ANNOTATIONS_INFO 1  /**< Set to 1 to include file, function, and line number annotations */
 
 // Enable/disable specific annotation types
@@ -44,34 +58,105 @@
 #define ANNOTATIONS_FUNC 1 /**< Set to 1 to include function name in annotations */
 #define ANNOTATIONS_LINE 1 /**< Set to 1 to include line number in annotations */
 
-// Default output function for logging
+// Writer configuration
+#define LOG_RING_SLOTS      128     /**< Number of diagnostics that can be queued for the writer thread */
+#define LOG_RECORD_LENGTH   512     /**< Maximum length of a single diagnostic, longer ones are truncated */
+#define LOG_SYSLOG_SOCKET   "/dev/log"  /**< Default socket of the syslog sink */
+#define LOG_IDENT           "modshell"  /**< Identifier used in syslog messages */
+
+// Environment variables read at startup
+#define LOG_LEVEL_ENV  "MODSHELL_LOG_LEVEL"  /**< off, error or debug */
+#define LOG_SINK_ENV   "MODSHELL_LOG_SINK"   /**< stderr, file:<path> or syslog[:<socket>] */
+
+extern int logLevel;  ///< Current runtime log level
+
+// Default output function for regular output
 #define LOG_OUT(...) printf(__VA_ARGS__)
 
-// Constructs the annotation string with file, function, and line information
-#define ANNOTATION_INFO_STRING do {\
-    if (ANNOTATIONS_INFO) {\
-        LOG_OUT(" ("); \
-        if (ANNOTATIONS_FILE) printf("%s", __FILE__); \
-        if (ANNOTATIONS_FILE && ANNOTATIONS_FUNC) printf(","); \
-        if (ANNOTATIONS_FUNC) printf("%s", __func__); \
-        if (ANNOTATIONS_FUNC && ANNOTATIONS_LINE) printf(","); \
-        if (ANNOTATIONS_LINE) printf("%d", __LINE__); \
-        LOG_OUT(") ");\
-    }\
-} while (0)
-
-// Macro for logging messages with optional annotations and color
+// Macro for logging messages. Costs a single, well-predicted branch when the message's type is filtered out.
 #define LOG(type, prefix, color, ...) \
     do { \
-        if (DEBUG) {\
-            LOG_OUT("%s%s%s: ", color, prefix, LOG_RESET); \
-            ANNOTATION_INFO_STRING; \
-            if (type == LOG_DBG) { \
-                LOG_OUT(__VA_ARGS__); \
-                break; \
-            } \
-        }\
-        if (type == LOG_ERR || type == LOG_PRI) { LOG_OUT(__VA_ARGS__); } \
+        if (type == LOG_PRI) { \
+            LOG_OUT(__VA_ARGS__); \
+        } else if (__builtin_expect((type) <= logLevel, 0)) { \
+            logWrite(type, prefix, color, __FILE__, __func__, __LINE__, __VA_ARGS__); \
+        } \
     } while (0)
 
+/**
+ * @brief Queues a diagnostic for the writer thread.
+ *
+ * Formats the message body into a free ring slot and wakes the writer, which adds the decorations and performs the I/O. Falls back to
+ * a synchronous write when the writer isn't running (e.g. in a forked child), when the ring is full, or when called re-entrantly from
+ * a signal handler. Use the LOG_ERROR and LOG_DEBUG macros rather than calling this directly.
+ *
+ * @param type The log type (LOG_ERR or LOG_DBG).
+ * @param prefix The prefix shown at the debug level, e.g. "[ERROR]".
+ * @param color The color of the prefix when the sink is a terminal.
+ * @param file The source file of the call site.
+ * @param func The function of the call site.
+ * @param line The line of the call site.
+ * @param format printf style format string, followed by its arguments.
+ */
+void logWrite(int type, const char* prefix, const char* color, const char* file, const char* func, int line, const char* format, ...)
+    __attribute__((format(printf, 7, 8)));
+
+/**
+ * @brief Initializes logging from the environment and starts the writer thread.
+ *
+ * Reads MODSHELL_LOG_LEVEL and MODSHELL_LOG_SINK, opens the sink and registers the fork and exit handlers. Diagnostics logged before
+ * this call are written synchronously to stderr.
+ *
+ * @return int 0 on success, -1 if the environment held an invalid setting (defaults are used in that case).
+ */
+int initLogging();
+
+/**
+ * @brief Marks the start or the end of a signal handler that may log.
+ *
+ * Diagnostics logged in between are written synchronously, without taking the ring's lock, allocating the ring or starting the writer
+ * thread, none of which is async-signal-safe.
+ *
+ * @param entering 1 when entering the handler, 0 when leaving it.
+ */
+void logSignalHandler(int entering);
+
+/**
+ * @brief Blocks until every queued diagnostic has been written.
+ *
+ * Called before printing the prompt so that diagnostics of the previous command appear before it.
+ */
+void logFlush();
+
+/**
+ * @brief Stops the writer thread and releases its ring buffer if no diagnostic is queued.
+ *
+ * The thread and the ring are created again by the next diagnostic. Used by the low-memory mode while the shell is idle, to give
+ * back the thread's stack along with the ring.
+ */
+void logTrim();
+
+/**
+ * @brief Sets the runtime log level from its name.
+ *
+ * @param name off, error or debug.
+ * @return int 0 on success, -1 if the name is unknown.
+ */
+int setLogLevel(const char* name);
+
+/**
+ * @brief Switches the log sink.
+ *
+ * Queued diagnostics are flushed to the previous sink first. On failure the previous sink is kept.
+ *
+ * @param spec stderr, file:<path> or syslog[:<socket>].
+ * @return int 0 on success, -1 if the specification is invalid or the sink can't be opened.
+ */
+int setLogSink(const char* spec);
+
+/**
+ * @brief Prints the current log level, sink and writer counters to stdout.
+ */
+void printLogStatus();
+
 #endif // LOG_H
@@ -24,11 +24,21 @@ typedef struct HistoryNode {
     struct HistoryNode* next;     /**< Pointer to the next node in the history list */
 } HistoryNode;
 
+// Number of history nodes after which the low-memory mode compacts the history between commands
+#define HISTORY_COMPACT_THRESHOLD 64
+
 // Structure to represent a list of commands in shell history
 typedef struct HistoryList {
     HistoryNode* head;            /**< Pointer to the first node in the history list */
     HistoryNode* tail;            /**< Pointer to the last node in the history list for quick insertions */
-    size_t size;                  /**< The number of commands in the history list */
+    size_t size;                  /**< The number of commands in the history list, archived ones included */
+
+    // Compacted part of the history. Older commands are stored back to back in a read-only mapping and come before the nodes.
+    char* archive;                /**< NUL-separated commands, or NULL if the history was never compacted */
+    size_t archiveLength;         /**< Bytes used in the archive */
+    size_t archiveMapped;         /**< Bytes mapped for the archive */
+    size_t archiveCount;          /**< Number of commands in the archive */
+    size_t nodeCount;             /**< Number of commands still held in nodes */
 } HistoryList;
 
 /**
@@ -62,6 +72,16 @@ char* get_command(HistoryList* list, unsigned int index);
  */
 void clean_history(HistoryList* list);
 
+/**
+ * @brief Moves the commands held in nodes into the read-only archive mapping.
+ * 
+ * This function copies the archive and every node's command into a new, tightly sized mapping, makes it read-only, and frees the nodes and the previous mapping. Indices and lookups are unaffected.
+ * 
+ * @param list The history list to compact.
+ * @return int Returns 0 on success, -1 on failure (the history is left unchanged).
+ */
+int compact_history(HistoryList* list);
+
 /**
  * @brief Finds the last command in the history that starts with the given prefix.
  * 
@@ -168,9 +188,69 @@ int pwd(SimpleCommand* command);
 int history(SimpleCommand* command);
 
 /**
- * @brief Executes a process by forking and executing the command.
+ * @brief Built-in function to inspect and tune the spawn admission controller.
+ * 
+ * This function prints the admission control settings and counters, or updates one setting when given a name and a value.
+ * 
+ * @param command The command to be executed, optionally including a setting name and its new value.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int spawnctl(SimpleCommand* command);
+
+/**
+ * @brief Built-in function to inspect and change the runtime logging configuration.
+ * 
+ * This function prints the log level, sink and writer counters, or changes the level or the sink at runtime.
+ * 
+ * @param command The command to be executed, optionally including a setting name and its new value.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int logCommand(SimpleCommand* command);
+
+/**
+ * @brief Built-in function to report the shell's memory usage.
+ * 
+ * This function prints the RSS and PSS of the shell process, read from /proc/self/smaps_rollup, and the history footprint.
+ * 
+ * @param command The command to be executed, which should be the memstat command.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int memstat(SimpleCommand* command);
+
+/**
+ * @brief Built-in function to list the background jobs.
+ * 
+ * This function prints the job table. With `-v`, it also prints the CPU usage, RSS and I/O of every process in each job's process group.
+ * 
+ * @param command The command to be executed, optionally including `-v`.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int jobsCommand(SimpleCommand* command);
+
+/**
+ * @brief Built-in function to monitor the background jobs live.
+ * 
+ * This function redraws the resource usage of every job's processes on a fixed interval until Enter is pressed or the jobs finish.
+ * 
+ * @param command The command to be executed, optionally including the interval in milliseconds and the number of samples.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int jobtop(SimpleCommand* command);
+
+/**
+ * @brief Built-in function to report the active execution backend.
+ * 
+ * This function prints the name of the backend and, for the simulated backend, its virtual clock and process counters.
+ * 
+ * @param command The command to be executed, which should be the backend command.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int backendCommand(SimpleCommand* command);
+
+/**
+ * @brief Executes a process through the active execution backend.
  * 
- * This function creates a child process, executes the command in the child process, and returns the execution status.
+ * This function starts the command with the backend, waits for it unless it runs in the background, and returns the execution status.
  * 
  * @param command The command to be executed.
  * @return int Returns 0 on success, non-zero on failure.
@@ -0,0 +1,122 @@
+/**
+ * @file spawn.h
+ * @brief Spawn admission control for child processes.
+ * @version 0.1
+ *
+ * This file declares the admission controller that sits in front of fork(). It caps the number of concurrently running children,
+ * queueing spawns until a child exits, retries transient fork failures (EAGAIN/ENOMEM) with jittered exponential backoff, and sheds load
+ * while the system load average or memory pressure (PSI) stays above the configured thresholds.
+ *
+ */
+
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include "utils.h"
+#include "command.h"
+
+#include <signal.h>
+#include <sys/types.h>
+
+/**
+ * @brief Status returned by the execution functions when a child process could not be spawned.
+ *
+ * Distinct from the regular -1 failure status so that the command chain can stop instead of running the remaining commands.
+ */
+#define SPAWN_FAILURE -2
+
+// Default admission control settings
+#define SPAWN_DEFAULT_MAX_CHILDREN    256     /**< Maximum number of concurrently running children (0 disables the cap) */
+#define SPAWN_DEFAULT_MAX_RETRIES     10      /**< Number of backoff rounds before giving up on a spawn */
+#define SPAWN_DEFAULT_BASE_DELAY_US   1000    /**< Initial backoff delay in microseconds */
+#define SPAWN_DEFAULT_MAX_DELAY_US    100000  /**< Upper bound on a single backoff delay in microseconds */
+#define SPAWN_DEFAULT_SAMPLE_MS       250     /**< Minimum interval between reads of /proc/loadavg and /proc/pressure/memory */
+
+// Upper bound on the backoff delay settings, which keeps the doubling of the delay from overflowing
+#define SPAWN_MAX_DELAY_LIMIT_US      60000000
+
+// Files sampled for load shedding
+#define SPAWN_LOADAVG_FILE      "/proc/loadavg"
+#define SPAWN_MEM_PRESSURE_FILE "/proc/pressure/memory"
+
+// Structure holding the tunables of the admission controller
+typedef struct SpawnConfig {
+    int maxChildren;              /**< Cap on concurrently running children, 0 for no cap */
+    int maxRetries;               /**< Backoff rounds before a spawn is refused */
+    long baseDelayUs;             /**< Backoff delay of the first round, doubled on every round */
+    long maxDelayUs;              /**< Upper bound on the backoff delay of a single round */
+    double loadavgThreshold;      /**< 1-minute load average above which spawns are delayed, 0 to disable */
+    double memPressureThreshold;  /**< PSI memory "some avg10" percentage above which spawns are delayed, 0 to disable */
+    long sampleIntervalMs;        /**< Minimum interval between two samples of the load files */
+} SpawnConfig;
+
+// Structure holding the counters exposed by the admission controller
+typedef struct SpawnStats {
+    unsigned long spawned;        /**< Children successfully forked */
+    unsigned long forkRetries;    /**< fork() calls that failed with EAGAIN/ENOMEM and were retried */
+    unsigned long forkFailures;   /**< Spawns refused after fork() kept failing */
+    unsigned long capWaits;       /**< Times a spawn waited for a child to exit because the cap was reached */
+    unsigned long pressureWaits;  /**< Backoff rounds spent waiting for load or memory pressure to drop */
+    unsigned long shed;           /**< Spawns refused because the pressure did not drop in time */
+    int peakChildren;             /**< Highest number of concurrently running children seen */
+} SpawnStats;
+
+extern SpawnConfig spawnConfig;                 ///< Active admission control settings
+extern SpawnStats spawnStats;                   ///< Admission control counters
+extern volatile sig_atomic_t activeChildren;    ///< Number of children forked and not yet reaped
+
+/**
+ * @brief Initializes the admission controller with its default settings.
+ *
+ * Resets the counters and seeds the backoff jitter. Must be called once before the first spawn.
+ */
+void initSpawnControl();
+
+/**
+ * @brief Starts a command through the admission controller.
+ *
+ * Waits for a free child slot, for as long as it takes, and for the load and memory pressure to drop below their thresholds, then starts
+ * the command with the active execution backend. Pressure and transient fork failures are retried with jittered exponential backoff,
+ * giving up after the configured number of rounds.
+ *
+ * @param simpleCommand The command to start.
+ * @return pid_t The child's pid, or -1 (with errno set) if the spawn was refused or failed.
+ */
+pid_t spawnProcess(SimpleCommand* simpleCommand);
+
+/**
+ * @brief Records that children have been reaped.
+ *
+ * Async-signal-safe when called from the SIGCHLD handler. Callers outside the handler must use spawnReapedSafe().
+ *
+ * @param count Number of children reaped.
+ */
+void spawnReaped(int count);
+
+/**
+ * @brief Records that children have been reaped, from outside the SIGCHLD handler.
+ *
+ * Blocks SIGCHLD while updating the counter so the update cannot race with the handler.
+ *
+ * @param count Number of children reaped.
+ */
+void spawnReapedSafe(int count);
+
+/**
+ * @brief Prints the admission control settings and counters.
+ */
+void printSpawnStats();
+
+/**
+ * @brief Updates one admission control setting.
+ *
+ * Recognized keys are `max-children`, `retries`, `base-delay-us`, `max-delay-us`, `loadavg`, `mem-pressure` and `sample-ms`. The
+ * thresholds `loadavg` and `mem-pressure` accept decimals, the other settings only integers within range.
+ *
+ * @param key The name of the setting.
+ * @param value The new value, as a string.
+ * @return int Returns 0 on success, -1 if the key is unknown or the value is invalid.
+ */
+int setSpawnOption(const char* key, const char* value);
+
+#endif // SPAWN_H
@@ -0,0 +1,113 @@
+/**
+ * @file startup.h
+ * @brief Declares the rc-file loader and the startup-time profiler.
+ * @version 0.1
+ *
+ * The rc file is read in one go and turned into a script plan (one tokenized entry per command line) before anything runs. The
+ * startup profiler times each startup phase and each rc line, and reports them when the shell is started with --startup-profile.
+ *
+ */
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include "utils.h"
+
+#include <time.h>
+
+// Name of the rc file, looked up in the home directory
+#define RC_FILE_NAME ".modshellrc"
+
+// Startup phases, in the order they run
+#define STARTUP_PHASE_LOGGING      0  /**< Logging setup and writer thread start */
+#define STARTUP_PHASE_STATE        1  /**< init_shell_state */
+#define STARTUP_PHASE_SPAWN        2  /**< Spawn admission control setup */
+#define STARTUP_PHASE_SIGNALS      3  /**< Signal handler registration */
+#define STARTUP_PHASE_HISTORY      4  /**< History load */
+#define STARTUP_PHASE_RC           5  /**< rc file load and execution */
+#define STARTUP_PHASES             6  /**< Number of startup phases */
+
+// Structure to represent one command line of a script plan
+typedef struct ScriptLine {
+    int lineNumber;     /**< 1-based line number in the source file */
+    char* text;         /**< The line, pointing into the plan's buffer */
+    char** tokens;      /**< The line's tokens, NULL-terminated */
+} ScriptLine;
+
+// Structure to represent a script read and tokenized ahead of execution
+typedef struct ScriptPlan {
+    char* buffer;       /**< The whole file, with its newlines replaced by NUL characters */
+    ScriptLine* lines;  /**< Command lines of the file, blank lines and comments excluded */
+    int nLines;         /**< Number of command lines */
+} ScriptPlan;
+
+// Structure to hold the timing of one rc line
+typedef struct RcLineTiming {
+    int lineNumber;     /**< Line number in the rc file */
+    double ms;          /**< Time spent parsing and executing the line */
+    char* text;         /**< Copy of the line, for the report */
+} RcLineTiming;
+
+// Structure to hold the startup profile
+typedef struct StartupProfile {
+    int enabled;                        /**< Whether --startup-profile was given */
+    struct timespec start;              /**< Time at which main() started */
+    struct timespec phaseStart;         /**< Time at which the current phase started */
+    double phaseMs[STARTUP_PHASES];     /**< Time spent in each phase, -1 for phases that didn't run */
+    RcLineTiming* rcLines;              /**< Per-line timings of the rc file */
+    int nRcLines;                       /**< Number of entries in rcLines */
+} StartupProfile;
+
+/**
+ * @brief Starts the startup profile clock.
+ *
+ * @param profile The profile to initialize.
+ * @param enabled Whether timings should be collected and reported.
+ */
+void initStartupProfile(StartupProfile* profile, int enabled);
+
+/**
+ * @brief Ends the current phase and starts the next one.
+ *
+ * @param profile The startup profile.
+ * @param phase The phase that just finished, one of the STARTUP_PHASE_* values.
+ */
+void endStartupPhase(StartupProfile* profile, int phase);
+
+/**
+ * @brief Prints the startup profile to stderr and frees its per-line timings.
+ *
+ * Does nothing if the profile is disabled.
+ *
+ * @param profile The startup profile.
+ */
+void reportStartupProfile(StartupProfile* profile);
+
+/**
+ * @brief Reads a script and tokenizes each of its command lines.
+ *
+ * Blank lines and lines starting with '#' are skipped. The caller is responsible for freeing the plan with cleanUpScriptPlan().
+ *
+ * @param path Path to the script.
+ * @return ScriptPlan* The plan, or NULL if the file can't be read.
+ */
+ScriptPlan* loadScriptPlan(const char* path);
+
+/**
+ * @brief Frees a script plan.
+ *
+ * @param plan The plan to free.
+ */
+void cleanUpScriptPlan(ScriptPlan* plan);
+
+/**
+ * @brief Runs the rc file from the home directory, if there is one.
+ *
+ * Each line of the plan is parsed and executed in order. A missing rc file is not an error.
+ *
+ * @param profile The startup profile, which receives the per-line timings when enabled.
+ * @return int 0 on success or if there is no rc file, -1 if it exists but can't be read.
+ */
+int runRcFile(StartupProfile* profile);
+
+#endif // STARTUP_H
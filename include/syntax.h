@@ -0,0 +1,122 @@
+/**
+ * @file syntax.h
+ * @brief Declares the incremental lexer and syntax checker used by the line editor.
+ * @version 0.1
+ *
+ * The checker keeps the tokens of the line being edited, with the parser state after each one. After an edit, only the tokens from the
+ * edited one onwards are lexed again, until a token boundary lines up with the previous lexing; the parser state is then recomputed
+ * until it lines up too. Typing or pasting at the end of the line therefore costs the same whatever the length of the line. An edit in
+ * the middle of the line still moves the tokens after it and shifts their offsets, so it costs O(number of tokens after the edit).
+ *
+ * Tokens follow the rules of tokenizeString(): they are separated by spaces, except inside quotes, and operators are whole tokens.
+ *
+ */
+
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+#include "utils.h"
+
+// Diagnostics attached to a token
+#define SYNTAX_OK                 0   /**< No problem */
+#define SYNTAX_UNKNOWN_COMMAND    1   /**< Command that is neither a builtin nor an executable in PATH */
+#define SYNTAX_MISPLACED_OPERATOR 2   /**< Operator where a command or a file name is expected */
+
+// Kinds of token
+#define TOKEN_WORD        0   /**< Command name, argument or file name */
+#define TOKEN_SEPARATOR   1   /**< `|`, `;` or `&`, followed by a command */
+#define TOKEN_REDIRECTION 2   /**< `<`, `>`, `>>` or `2>`, followed by a file name */
+
+// Parser states, what the next token is expected to be
+#define EXPECT_COMMAND 0   /**< A command name */
+#define EXPECT_ARG     1   /**< An argument or an operator */
+#define EXPECT_TARGET  2   /**< The file name of a redirection */
+
+// Structure to represent a token of the edited line
+typedef struct SyntaxToken {
+    int start;          /**< Offset of the token's first character */
+    int end;            /**< Offset just past the token's last character */
+    int kind;           /**< TOKEN_* */
+    int unterminated;   /**< Whether the token ends inside quotes */
+    int expectBefore;   /**< Parser state before the token */
+    int expectAfter;    /**< Parser state after the token */
+    int error;          /**< SYNTAX_* */
+} SyntaxToken;
+
+// Structure holding the incremental lexer and parser state of a line
+typedef struct SyntaxState {
+    SyntaxToken tokens[MAX_STRING_LENGTH / 2 + 1];  /**< Tokens, in order, at most one per two characters */
+    int nTokens;                                     /**< Number of tokens */
+    int nErrors;                                     /**< Number of tokens with a diagnostic */
+    int changedFrom;                                 /**< First token whose text, kind or diagnostic may have changed in the last edit */
+} SyntaxState;
+
+/**
+ * @brief Resets the state for an empty line.
+ *
+ * @param state The state.
+ */
+void initSyntaxState(SyntaxState* state);
+
+/**
+ * @brief Updates the state after an edit of the line.
+ *
+ * Lexing and parsing stop once they line up with the previous state, but the tokens after the edit are moved and their offsets shifted,
+ * which is O(number of tokens after the edit). Appending costs the same whatever the length of the line.
+ *
+ * @param state The state, matching the line before the edit.
+ * @param line The line after the edit.
+ * @param length Length of the line after the edit.
+ * @param position Offset of the edit.
+ * @param removed Number of characters removed at that offset.
+ * @param inserted Number of characters inserted at that offset, in place of the removed ones.
+ */
+void syntaxEdit(SyntaxState* state, const char* line, int length, int position, int removed, int inserted);
+
+/**
+ * @brief Finds the token at an offset.
+ *
+ * @param state The state.
+ * @param position The offset.
+ * @return int Index of the last token starting at or before the offset, or -1 if there is none.
+ */
+int syntaxTokenAt(SyntaxState* state, int position);
+
+/**
+ * @brief Describes the most relevant problem of the line near an offset.
+ *
+ * An unbalanced quote or a dangling operator at the end of the line is reported first, then the diagnostic of the token at the offset.
+ *
+ * @param state The state.
+ * @param line The line.
+ * @param position The offset, usually the cursor.
+ * @param buffer Where to write the description.
+ * @param size Size of the buffer.
+ * @return int 1 if there is something to report, 0 otherwise.
+ */
+int describeSyntax(SyntaxState* state, const char* line, int position, char* buffer, size_t size);
+
+/**
+ * @brief Rebuilds the PATH cache if PATH or one of its directories changed since it was built.
+ *
+ * Cheap enough to be called before every line: the cache is only rebuilt when the next lookup needs it.
+ */
+void refreshPathCache();
+
+/**
+ * @brief Checks whether a name is a builtin or an executable found in PATH.
+ *
+ * Names containing a '/' are checked directly. The PATH cache is built on the first lookup.
+ *
+ * @param name The command name.
+ * @param length Length of the name.
+ * @return int 1 if the command exists, 0 otherwise.
+ */
+int commandExists(const char* name, int length);
+
+/**
+ * @brief Frees the PATH cache. It is rebuilt on the next lookup.
+ */
+void freePathCache();
+
+#endif // SYNTAX_H
@@ -0,0 +1,736 @@
+/**
+ * @file backend.c
+ * @brief Function definitions for the Linux and simulated execution backends.
+ * @version 0.1
+ *
+ * The simulated backend keeps a virtual clock in microseconds. A simulated process starts at the current virtual time and ends its
+ * runtime later; waiting for it moves the clock forward to its end. Background processes are reaped automatically once the clock passes
+ * their end, which is what the SIGCHLD handler does for real ones.
+ *
+ */
+
+#include "backend.h"
+#include "spawn.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+const ExecBackend* execBackend = &linuxBackend;  ///< The active backend
+
+/*-------------------------------Linux Backend----------------------------------*/
+
+/**
+ * @brief Moves a redirected file descriptor onto its standard slot in a child process.
+ *
+ * @param fd The redirected file descriptor.
+ * @param target The standard file descriptor it replaces.
+ */
+static void redirectFD(int fd, int target)
+{
+    if (fd == target)
+        return;
+
+    if (dup2(fd, target) == -1)
+    {
+        LOG_ERROR("dup2: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    close(fd);
+}
+
+/**
+ * @brief Forks and executes a command.
+ *
+ * @param simpleCommand The command to start.
+ * @return pid_t The child's pid in the parent, -1 if fork() failed. Doesn't return in the child.
+ */
+static pid_t linuxSpawn(SimpleCommand* simpleCommand)
+{
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        if (simpleCommand->pgid != -1)
+            setpgid(0, simpleCommand->pgid);
+
+        redirectFD(simpleCommand->inputFD, STDIN_FD);
+        redirectFD(simpleCommand->outputFD, STDOUT_FD);
+        redirectFD(simpleCommand->stderrFD, STDERR_FD);
+
+        // The parent blocks SIGCHLD while spawning, the command must not inherit that
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+        execvp(simpleCommand->commandName, simpleCommand->args);
+        LOG_ERROR("%s: %s\n", simpleCommand->commandName, strerror(errno));
+        exit(1);
+    }
+
+    // Set the process group from the parent too, so it is in place whichever of the two runs first
+    if (pid > 0 && simpleCommand->pgid != -1)
+        setpgid(pid, simpleCommand->pgid ? simpleCommand->pgid : pid);
+
+    return pid;
+}
+
+// Sleeps on the real clock. A signal cuts the sleep short, which is fine for the spawn backoff
+static void linuxSleep(long us)
+{
+    struct timespec ts = { us / 1000000L, (us % 1000000L) * 1000L };
+    nanosleep(&ts, NULL);
+}
+
+// Waits for SIGCHLD with the given mask. sigsuspend() can't miss a child that exited since the caller blocked the signal
+static void linuxWaitChild(const sigset_t* mask)
+{
+    sigset_t waitMask = *mask;
+    sigdelset(&waitMask, SIGCHLD);
+    sigsuspend(&waitMask);
+}
+
+// Probes a pid, which is only reliable until the pid is reused
+static int linuxAlive(pid_t pid)
+{
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+// Opens a file. open() is variadic, so it can't be stored in the backend directly
+static int linuxOpen(const char* path, int flags, mode_t mode)
+{
+    return open(path, flags, mode);
+}
+
+const ExecBackend linuxBackend = {
+    .name       = "linux",
+    .init       = NULL,
+    .spawn      = linuxSpawn,
+    .wait       = waitpid,
+    .alive      = linuxAlive,
+    .waitChild  = linuxWaitChild,
+    .pipe       = pipe,
+    .open       = linuxOpen,
+    .close      = close,
+    .sleep      = linuxSleep,
+    .printStats = NULL,
+};
+
+/*-------------------------------Simulated Backend----------------------------------*/
+
+// Time a simulated fork() takes on the virtual clock, in microseconds
+#define SIM_SPAWN_COST_US 20
+
+// Default runtime of a simulated process, in microseconds
+#define SIM_DEFAULT_RUNTIME_US 1000
+
+// A simulated pid holds the generation of its slot above the slot number, so that a reused slot gets a new pid. Like real pids, they
+// only repeat once the generations wrap around.
+#define SIM_SLOT_BITS       20
+#define SIM_PID_GENERATIONS 1024
+
+// Structure to represent a simulated process
+typedef struct SimProcess {
+    int inUse;              /**< Whether the slot holds a process that hasn't been reaped */
+    int detached;           /**< Background process, reaped automatically once it has ended */
+    unsigned int gen;       /**< Incremented every time the slot is reused, to spot stale heap entries */
+    long long endUs;        /**< Virtual time at which the process exits */
+    int status;             /**< Wait status reported when the process is reaped */
+} SimProcess;
+
+// Entry of the heap of processes ordered by end time
+typedef struct SimEvent {
+    long long endUs;
+    int slot;
+    unsigned int gen;
+} SimEvent;
+
+// Structure to represent a simulated file descriptor
+typedef struct SimFile {
+    int inUse;                   /**< Whether the descriptor is open */
+    int peer;                    /**< Slot of the read end, for the write end of a pipe, -1 otherwise */
+    unsigned long long buffered; /**< Bytes written to the pipe and not read yet, for the read end of a pipe */
+} SimFile;
+
+// Configuration of the simulated processes
+static long long simRuntimeUs = SIM_DEFAULT_RUNTIME_US;
+static int simExitStatus = 0;
+static const char* simOutput = NULL;
+static int simPidsMax = 0;
+
+// Process table, indexed by the low SIM_SLOT_BITS bits of the pid
+static SimProcess* processes = NULL;
+static int nProcesses = 0;
+static int* freeProcesses = NULL;
+static int nFreeProcesses = 0;
+static int liveProcesses = 0;
+
+// Heap of live processes ordered by end time
+static SimEvent* events = NULL;
+static int nEvents = 0;
+static int eventsCapacity = 0;
+
+// File descriptor table, slot i holding descriptor SIM_FD_BASE + i
+static SimFile* files = NULL;
+static int nFiles = 0;
+static int* freeFiles = NULL;
+static int nFreeFiles = 0;
+
+// Virtual clock and counters
+static long long nowUs = 0;
+static unsigned long simSpawned = 0;
+static unsigned long simReaped = 0;
+static unsigned long simRefused = 0;
+static unsigned long simPipes = 0;
+static unsigned long simOpens = 0;
+static unsigned long long simPipeBytes = 0;
+static int simPeak = 0;
+
+/**
+ * @brief Reads a numeric setting from the environment.
+ *
+ * @param name The environment variable.
+ * @param fallback The value used when the variable is unset or invalid.
+ * @return long long The setting.
+ */
+static long long envNumber(const char* name, long long fallback)
+{
+    const char* value = getenv(name);
+    if (!value)
+        return fallback;
+
+    char* end = NULL;
+    long long number = strtoll(value, &end, 10);
+    if (end == value || *end != '\0' || number < 0)
+    {
+        LOG_ERROR("%s: expects a non-negative number\n", name);
+        return fallback;
+    }
+
+    return number;
+}
+
+// Reads the simulated process settings from the environment
+static void simInit()
+{
+    simRuntimeUs = envNumber(SIM_RUNTIME_ENV, SIM_DEFAULT_RUNTIME_US);
+    simExitStatus = (int)envNumber(SIM_EXIT_ENV, 0) & 0xff;
+    simOutput = getenv(SIM_OUTPUT_ENV);
+    simPidsMax = (int)envNumber(SIM_PIDS_MAX_ENV, 0);
+}
+
+/**
+ * @brief Doubles a table of slots and pushes the new slots on its free list.
+ *
+ * @param table The table.
+ * @param count Number of slots in the table, updated.
+ * @param freeList The free list, with room for every slot.
+ * @param nFree Number of entries in the free list, updated.
+ * @param size Size of one slot.
+ * @return int 0 on success, -1 on allocation failure.
+ */
+static int growTable(void** table, int* count, int** freeList, int* nFree, size_t size)
+{
+    int newCount = *count ? *count * 2 : 64;
+
+    void* temp = realloc(*table, newCount * size);
+    if (!temp)
+        return -1;
+    *table = temp;
+
+    int* tempFree = realloc(*freeList, newCount * sizeof(int));
+    if (!tempFree)
+        return -1;
+    *freeList = tempFree;
+
+    memset((char*)*table + *count * size, 0, (newCount - *count) * size);
+
+    // Lowest slots on top, so that pids and descriptors are handed out in increasing order
+    for (int i = newCount - 1; i >= *count; i--)
+        (*freeList)[(*nFree)++] = i;
+
+    *count = newCount;
+    return 0;
+}
+
+/*---Event heap---*/
+
+// Pushes a process onto the heap of end times
+static int pushEvent(long long endUs, int slot, unsigned int gen)
+{
+    if (nEvents == eventsCapacity)
+    {
+        int capacity = eventsCapacity ? eventsCapacity * 2 : 64;
+        SimEvent* temp = realloc(events, capacity * sizeof(SimEvent));
+        if (!temp)
+            return -1;
+        events = temp;
+        eventsCapacity = capacity;
+    }
+
+    int i = nEvents++;
+    while (i > 0 && events[(i - 1) / 2].endUs > endUs)
+    {
+        events[i] = events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    events[i] = (SimEvent){ endUs, slot, gen };
+    return 0;
+}
+
+// Removes the earliest event from the heap
+static void popEvent()
+{
+    SimEvent last = events[--nEvents];
+    int i = 0;
+
+    for (;;)
+    {
+        int child = 2 * i + 1;
+        if (child >= nEvents)
+            break;
+        if (child + 1 < nEvents && events[child + 1].endUs < events[child].endUs)
+            child++;
+        if (events[child].endUs >= last.endUs)
+            break;
+
+        events[i] = events[child];
+        i = child;
+    }
+
+    if (nEvents > 0)
+        events[i] = last;
+}
+
+// Checks whether a heap entry still refers to a live process
+static int eventValid(SimEvent* event)
+{
+    return processes[event->slot].inUse && processes[event->slot].gen == event->gen;
+}
+
+/*---Processes---*/
+
+// Computes the pid of the process in a slot
+static pid_t slotPid(int slot)
+{
+    return SIM_PID_BASE + (int)(((processes[slot].gen - 1) % SIM_PID_GENERATIONS) << SIM_SLOT_BITS) + slot;
+}
+
+/**
+ * @brief Finds the slot of a simulated process.
+ *
+ * @param pid The pid.
+ * @return int The slot, or -1 if no unreaped process has that pid.
+ */
+static int pidSlot(pid_t pid)
+{
+    if (pid < SIM_PID_BASE)
+        return -1;
+
+    int slot = (pid - SIM_PID_BASE) & ((1 << SIM_SLOT_BITS) - 1);
+    if (slot >= nProcesses || !processes[slot].inUse || slotPid(slot) != pid)
+        return -1;
+
+    return slot;
+}
+
+/**
+ * @brief Reaps a simulated process.
+ *
+ * @param slot The process slot.
+ * @param status Where to store the wait status, may be NULL.
+ * @return pid_t The pid of the reaped process.
+ */
+static pid_t reapSlot(int slot, int* status)
+{
+    if (status)
+        *status = processes[slot].status;
+
+    processes[slot].inUse = 0;
+    freeProcesses[nFreeProcesses++] = slot;
+    liveProcesses--;
+    simReaped++;
+
+    return slotPid(slot);
+}
+
+/**
+ * @brief Reaps the background processes that have ended by the current virtual time, like the SIGCHLD handler does.
+ *
+ * Stops at the first ended foreground process, which is left for its waiter.
+ */
+static void reapDetached()
+{
+    int reaped = 0;
+
+    while (nEvents > 0 && events[0].endUs <= nowUs)
+    {
+        if (!eventValid(&events[0]))
+        {
+            popEvent();
+            continue;
+        }
+
+        int slot = events[0].slot;
+        if (!processes[slot].detached)
+            break;
+
+        popEvent();
+        reapSlot(slot, NULL);
+        reaped++;
+    }
+
+    if (reaped)
+        spawnReapedSafe(reaped);
+}
+
+// Moves the virtual clock forward
+static void advanceClock(long long us)
+{
+    nowUs += us;
+    reapDetached();
+}
+
+/**
+ * @brief Computes the runtime of a simulated command.
+ *
+ * `sleep N` runs for N seconds, anything else for the configured runtime.
+ *
+ * @param simpleCommand The command.
+ * @return long long The runtime in microseconds.
+ */
+static long long simRuntime(SimpleCommand* simpleCommand)
+{
+    if (strcmp(simpleCommand->commandName, "sleep") == 0 && simpleCommand->argc > 1)
+        return (long long)(strtod(simpleCommand->args[1], NULL) * 1000000.0);
+
+    return simRuntimeUs;
+}
+
+/**
+ * @brief Computes the exit status of a simulated command.
+ *
+ * `true` and `false` behave as usual, anything else exits with the configured status.
+ *
+ * @param simpleCommand The command.
+ * @return int The exit status.
+ */
+static int simExit(SimpleCommand* simpleCommand)
+{
+    if (strcmp(simpleCommand->commandName, "true") == 0)
+        return 0;
+    if (strcmp(simpleCommand->commandName, "false") == 0)
+        return 1;
+
+    return simExitStatus;
+}
+
+/**
+ * @brief Produces the output of a simulated command.
+ *
+ * `echo` prints its arguments, anything else the configured output. Output to the shell's stdout is really written, output to a
+ * simulated pipe is buffered in the pipe, output to a simulated file is discarded.
+ *
+ * @param simpleCommand The command.
+ */
+static void simWrite(SimpleCommand* simpleCommand)
+{
+    char buffer[MAX_STRING_LENGTH];
+    int length = 0;
+
+    if (strcmp(simpleCommand->commandName, "echo") == 0)
+    {
+        for (int i = 1; i < simpleCommand->argc && length < (int)sizeof(buffer); i++)
+            length += snprintf(buffer + length, sizeof(buffer) - length, "%s%s", i > 1 ? " " : "", simpleCommand->args[i]);
+
+        if (length < (int)sizeof(buffer))
+            length += snprintf(buffer + length, sizeof(buffer) - length, "\n");
+    }
+    else if (simOutput)
+    {
+        length = snprintf(buffer, sizeof(buffer), "%s\n", simOutput);
+    }
+
+    if (length <= 0)
+        return;
+    if (length > (int)sizeof(buffer) - 1)
+        length = sizeof(buffer) - 1;
+
+    int fd = simpleCommand->outputFD;
+    if (fd < SIM_FD_BASE)
+    {
+        if (write(fd, buffer, length) == -1)
+            LOG_DEBUG("write: %s\n", strerror(errno));
+        return;
+    }
+
+    int peer = files[fd - SIM_FD_BASE].peer;
+    if (peer != -1 && files[peer].inUse)
+    {
+        files[peer].buffered += length;
+        simPipeBytes += length;
+    }
+}
+
+// Starts a simulated process
+static pid_t simSpawn(SimpleCommand* simpleCommand)
+{
+    if (simPidsMax > 0 && liveProcesses >= simPidsMax)
+    {
+        simRefused++;
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (nFreeProcesses == 0)
+    {
+        if (nProcesses >= (1 << SIM_SLOT_BITS))
+        {
+            simRefused++;
+            errno = EAGAIN;
+            return -1;
+        }
+
+        if (growTable((void**)&processes, &nProcesses, &freeProcesses, &nFreeProcesses, sizeof(SimProcess)) != 0)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    advanceClock(SIM_SPAWN_COST_US);
+
+    int slot = freeProcesses[--nFreeProcesses];
+    SimProcess* process = &processes[slot];
+    process->inUse = 1;
+    process->detached = simpleCommand->noWait;
+    process->gen++;
+    process->endUs = nowUs + simRuntime(simpleCommand);
+    process->status = simExit(simpleCommand) << 8;
+
+    if (pushEvent(process->endUs, slot, process->gen) != 0)
+    {
+        process->inUse = 0;
+        freeProcesses[nFreeProcesses++] = slot;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // The process reads everything buffered in its input pipe, then writes its output
+    if (simpleCommand->inputFD >= SIM_FD_BASE)
+        files[simpleCommand->inputFD - SIM_FD_BASE].buffered = 0;
+    simWrite(simpleCommand);
+
+    liveProcesses++;
+    simSpawned++;
+    if (liveProcesses > simPeak)
+        simPeak = liveProcesses;
+
+    return slotPid(slot);
+}
+
+// Waits for a simulated process, with the contract of waitpid()
+static pid_t simWait(pid_t pid, int* status, int options)
+{
+    if (pid > 0)
+    {
+        int slot = pidSlot(pid);
+        if (slot == -1)
+        {
+            errno = ECHILD;
+            return -1;
+        }
+
+        if (processes[slot].endUs > nowUs)
+        {
+            if (options & WNOHANG)
+                return 0;
+            nowUs = processes[slot].endUs;
+        }
+
+        reapSlot(slot, status);
+        reapDetached();
+        return pid;
+    }
+
+    // Any process: the one that ends first
+    while (nEvents > 0 && !eventValid(&events[0]))
+        popEvent();
+
+    if (nEvents == 0)
+    {
+        errno = ECHILD;
+        return -1;
+    }
+
+    if (events[0].endUs > nowUs)
+    {
+        if (options & WNOHANG)
+            return 0;
+        nowUs = events[0].endUs;
+    }
+
+    int slot = events[0].slot;
+    popEvent();
+    return reapSlot(slot, status);
+}
+
+// Moves the virtual clock to the end of the next process to exit
+static void simWaitChild(const sigset_t* mask)
+{
+    (void)mask;
+
+    while (nEvents > 0 && !eventValid(&events[0]))
+        popEvent();
+
+    if (nEvents > 0 && events[0].endUs > nowUs)
+        advanceClock(events[0].endUs - nowUs);
+}
+
+// Checks whether a simulated process hasn't ended by the current virtual time
+static int simAlive(pid_t pid)
+{
+    int slot = pidSlot(pid);
+    return slot != -1 && processes[slot].endUs > nowUs;
+}
+
+/**
+ * @brief Allocates a simulated file descriptor.
+ *
+ * @return int The descriptor, or -1 on allocation failure.
+ */
+static int allocFile()
+{
+    if (nFreeFiles == 0)
+    {
+        if (growTable((void**)&files, &nFiles, &freeFiles, &nFreeFiles, sizeof(SimFile)) != 0)
+        {
+            errno = EMFILE;
+            return -1;
+        }
+    }
+
+    int slot = freeFiles[--nFreeFiles];
+    files[slot].inUse = 1;
+    files[slot].peer = -1;
+    files[slot].buffered = 0;
+
+    return SIM_FD_BASE + slot;
+}
+
+// Creates a simulated pipe
+static int simPipe(int fds[2])
+{
+    int readFD = allocFile();
+    if (readFD == -1)
+        return -1;
+
+    int writeFD = allocFile();
+    if (writeFD == -1)
+    {
+        files[readFD - SIM_FD_BASE].inUse = 0;
+        freeFiles[nFreeFiles++] = readFD - SIM_FD_BASE;
+        return -1;
+    }
+
+    files[writeFD - SIM_FD_BASE].peer = readFD - SIM_FD_BASE;
+    fds[PIPE_READ_END] = readFD;
+    fds[PIPE_WRITE_END] = writeFD;
+    simPipes++;
+
+    return 0;
+}
+
+// Opens a simulated file. Nothing is created on disk
+static int simOpen(const char* path, int flags, mode_t mode)
+{
+    (void)path;
+    (void)flags;
+    (void)mode;
+
+    simOpens++;
+    return allocFile();
+}
+
+// Closes a simulated file descriptor, or a real one that predates the backend
+static int simClose(int fd)
+{
+    if (fd < SIM_FD_BASE)
+        return close(fd);
+
+    int slot = fd - SIM_FD_BASE;
+    if (slot >= nFiles || !files[slot].inUse)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    files[slot].inUse = 0;
+    freeFiles[nFreeFiles++] = slot;
+    return 0;
+}
+
+// Sleeps on the virtual clock
+static void simSleep(long us)
+{
+    advanceClock(us);
+}
+
+// Prints the virtual clock and the simulation counters
+static void simPrintStats()
+{
+    LOG_PRINT("virtual-time   %lld.%06lld s\n", nowUs / 1000000LL, nowUs % 1000000LL);
+    LOG_PRINT("spawned        %lu\n", simSpawned);
+    LOG_PRINT("reaped         %lu\n", simReaped);
+    LOG_PRINT("live           %d\n", liveProcesses);
+    LOG_PRINT("peak           %d\n", simPeak);
+    LOG_PRINT("refused        %lu\n", simRefused);
+    LOG_PRINT("pipes          %lu\n", simPipes);
+    LOG_PRINT("pipe-bytes     %llu\n", simPipeBytes);
+    LOG_PRINT("opens          %lu\n", simOpens);
+    LOG_PRINT("runtime-us     %lld\n", simRuntimeUs);
+    LOG_PRINT("exit           %d\n", simExitStatus);
+    LOG_PRINT("pids-max       %d\n", simPidsMax);
+}
+
+const ExecBackend simBackend = {
+    .name       = "sim",
+    .init       = simInit,
+    .spawn      = simSpawn,
+    .wait       = simWait,
+    .alive      = simAlive,
+    .waitChild  = simWaitChild,
+    .pipe       = simPipe,
+    .open       = simOpen,
+    .close      = simClose,
+    .sleep      = simSleep,
+    .printStats = simPrintStats,
+};
+
+/*-------------------------------Selection----------------------------------*/
+
+// Makes a backend the active one
+int selectBackend(const char* name)
+{
+    static const ExecBackend* backends[] = { &linuxBackend, &simBackend, NULL };
+
+    for (int i = 0; backends[i]; i++)
+    {
+        if (strcmp(backends[i]->name, name) == 0)
+        {
+            execBackend = backends[i];
+            if (execBackend->init)
+                execBackend->init();
+            return 0;
+        }
+    }
+
+    return -1;
+}
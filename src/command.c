@@ -8,6 +8,9 @@
  */
 
 #include "command.h"
+#include "spawn.h"
+#include "jobs.h"
+#include "backend.h"
 
 // Macro to check if the previous command is chained with a specific operator
 #define CHAINED_WITH(opr) (prevCommand ? (prevCommand->chainingOperator ? (strcmp(prevCommand->chainingOperator, opr) == 0) : 0) : 0)
@@ -34,6 +37,7 @@ SimpleCommand* initSimpleCommand()
     simpleCommand->noWait      = 0;
     simpleCommand->execute     = NULL;
     simpleCommand->pid         = -1;
+    simpleCommand->pgid        = -1;
 
     return simpleCommand;
 }
@@ -188,6 +192,13 @@ int executeCommandChain(CommandChain* chain)
     {   
         lastStatus = executeCommand(command);  // Execute the current command
 
+        // A spawn failure means the system is out of processes or memory, running the rest of the chain would only fail at random
+        if (lastStatus == SPAWN_FAILURE)
+        {
+            LOG_ERROR("Unable to spawn process, skipping the rest of the command chain\n");
+            break;
+        }
+
         command = command->next;  // Move to the next command in the chain
     }
 
@@ -215,9 +226,12 @@ int executeCommand(Command* command)
         LOG_DEBUG("Executing command : %s\n", command->simpleCommands[i]->commandName);
         SimpleCommand* simpleCommand = command->simpleCommands[i];
 
-        // If the command is to be run in the background, set noWait flag
+        // If the command is to be run in the background, set noWait flag and run it in its own process group, led by its first process
         if (command->background)
+        {
             simpleCommand->noWait = 1;
+            simpleCommand->pgid = (i > 0 && command->simpleCommands[0]->pid > 0) ? command->simpleCommands[0]->pid : 0;
+        }
 
         // Check if the command name is empty and return an error if so
         if (!simpleCommand->commandName)
@@ -233,20 +247,58 @@ int executeCommand(Command* command)
         // If the command execution failed, return the status
         if (status)
         {
+            // Close the pipes of the stages that won't run so the stages already running see EOF instead of blocking
+            if (status == SPAWN_FAILURE)
+                closeCommandFDs(command, i);
+
             return status;
         }
 
         // Close file descriptors if they were redirected
         if (simpleCommand->inputFD != STDIN_FD)
-            close(simpleCommand->inputFD);
+            execBackend->close(simpleCommand->inputFD);
         
         if (simpleCommand->outputFD != STDOUT_FD)
-            close(simpleCommand->outputFD);
+            execBackend->close(simpleCommand->outputFD);
     }
 
+    // Track background commands in the job table
+    if (command->background)
+        addJob(command);
+
     return 0;  // Return success code
 }
 
+// Closes the redirected file descriptors of the SimpleCommands from the given index onwards
+void closeCommandFDs(Command* command, int from)
+{
+    if (!command)
+        return;  // Return if the Command is NULL
+
+    for (int i = from; i < command->nSimpleCommands; i++)
+    {
+        SimpleCommand* simpleCommand = command->simpleCommands[i];
+
+        if (simpleCommand->inputFD != STDIN_FD)
+        {
+            execBackend->close(simpleCommand->inputFD);
+            simpleCommand->inputFD = STDIN_FD;
+        }
+
+        if (simpleCommand->outputFD != STDOUT_FD)
+        {
+            execBackend->close(simpleCommand->outputFD);
+            simpleCommand->outputFD = STDOUT_FD;
+        }
+
+        if (simpleCommand->stderrFD != STDERR_FD)
+        {
+            execBackend->close(simpleCommand->stderrFD);
+            simpleCommand->stderrFD = STDERR_FD;
+        }
+    }
+}
+
 /*-------------------------------Clean up functions---------------------------------------*/
 
 // Frees memory allocated for a SimpleCommand
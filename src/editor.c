@@ -0,0 +1,480 @@
+/**
+ * @file editor.c
+ * @brief Function definitions for the interactive line editor.
+ * @version 0.1
+ *
+ * Screen positions are counted in cells from the start of the prompt, one cell per byte, and converted to rows and columns with the
+ * terminal width when the cursor is moved, so lines longer than the terminal wraps are redrawn correctly.
+ *
+ */
+
+#include "editor.h"
+#include "syntax.h"
+#include "footprint.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+// Styles used for the inline feedback
+#define EDITOR_ERROR_STYLE "\033[4;31m"   /**< Tokens with a problem: red, underlined */
+#define EDITOR_HINT_STYLE  "\033[2m"      /**< Description of the problem: dim */
+#define EDITOR_RESET_STYLE "\033[0m"
+
+// Keys
+#define KEY_CTRL(c)   ((c) & 0x1f)
+#define KEY_ESCAPE    27
+#define KEY_BACKSPACE 127
+
+// Size of the buffer a redraw is assembled in before being written in one go
+#define EDITOR_OUTPUT_SIZE 16384
+
+// Structure holding the state of the line being edited
+typedef struct LineEditor {
+    char line[MAX_STRING_LENGTH];  /**< The line, NUL-terminated */
+    int length;                    /**< Length of the line */
+    int cursor;                    /**< Offset of the cursor in the line */
+    int promptWidth;               /**< Cells taken by the prompt */
+    int columns;                   /**< Width of the terminal */
+    int screenPos;                 /**< Cell the terminal cursor is on, counted from the start of the prompt */
+    SyntaxState syntax;            /**< Incremental lexer and parser state of the line */
+} LineEditor;
+
+static int editorEnabled = 0;
+
+// Bytes read from the terminal and not consumed yet. Kept across lines, so a pasted block is edited one line at a time
+static unsigned char pending[256];
+static int pendingLength = 0;
+static int pendingPos = 0;
+
+// Redraw being assembled
+static char output[EDITOR_OUTPUT_SIZE];
+static int outputLength = 0;
+
+/*-------------------------------Terminal I/O----------------------------------*/
+
+// Writes the assembled output to the terminal
+static void flushOutput()
+{
+    int written = 0;
+    while (written < outputLength)
+    {
+        ssize_t n = write(STDOUT_FD, output + written, outputLength - written);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        written += n;
+    }
+
+    outputLength = 0;
+}
+
+// Appends bytes to the output
+static void append(const char* text, int length)
+{
+    if (outputLength + length > EDITOR_OUTPUT_SIZE)
+        flushOutput();
+
+    if (length > EDITOR_OUTPUT_SIZE)
+    {
+        if (write(STDOUT_FD, text, length) == -1)
+            LOG_DEBUG("write: %s\n", strerror(errno));
+        return;
+    }
+
+    memcpy(output + outputLength, text, length);
+    outputLength += length;
+}
+
+// Appends a NUL-terminated string to the output
+static void appendString(const char* text)
+{
+    append(text, strlen(text));
+}
+
+/**
+ * @brief Reads the next byte typed, refilling the pending input as needed.
+ *
+ * @return int The byte, or -1 at end of file or on error.
+ */
+static int readByte()
+{
+    if (pendingPos == pendingLength)
+    {
+        ssize_t n;
+        do {
+            n = read(STDIN_FD, pending, sizeof(pending));
+        } while (n == -1 && errno == EINTR);
+
+        if (n <= 0)
+            return -1;
+
+        pendingLength = n;
+        pendingPos = 0;
+    }
+
+    return pending[pendingPos++];
+}
+
+// Returns the width of the terminal
+static int terminalColumns()
+{
+    struct winsize ws;
+    if (ioctl(STDOUT_FD, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0)
+        return 80;
+    return ws.ws_col;
+}
+
+/*-------------------------------Drawing----------------------------------*/
+
+/**
+ * @brief Moves the terminal cursor to a cell.
+ *
+ * @param editor The editor.
+ * @param target The cell, counted from the start of the prompt.
+ */
+static void moveTo(LineEditor* editor, int target)
+{
+    char sequence[32];
+    int fromRow = editor->screenPos / editor->columns;
+    int toRow = target / editor->columns;
+
+    if (toRow < fromRow)
+        append(sequence, snprintf(sequence, sizeof(sequence), "\033[%dA", fromRow - toRow));
+    else if (toRow > fromRow)
+        append(sequence, snprintf(sequence, sizeof(sequence), "\033[%dB", toRow - fromRow));
+
+    appendString("\r");
+    if (target % editor->columns)
+        append(sequence, snprintf(sequence, sizeof(sequence), "\033[%dC", target % editor->columns));
+
+    editor->screenPos = target;
+}
+
+/**
+ * @brief Redraws the line from an offset to its end, then the hint, and puts the cursor back.
+ *
+ * @param editor The editor.
+ * @param from The first offset that changed.
+ */
+static void redraw(LineEditor* editor, int from)
+{
+    SyntaxState* syntax = &editor->syntax;
+    editor->columns = terminalColumns();
+    moveTo(editor, editor->promptWidth + from);
+
+    int i = from;
+    int t = syntaxTokenAt(syntax, from);
+    if (t == -1)
+        t = 0;
+
+    while (i < editor->length)
+    {
+        while (t < syntax->nTokens && syntax->tokens[t].end <= i)
+            t++;
+
+        if (t < syntax->nTokens && syntax->tokens[t].start <= i)
+        {
+            SyntaxToken* token = &syntax->tokens[t];
+            int flagged = token->error != SYNTAX_OK || token->unterminated;
+
+            if (flagged)
+                appendString(EDITOR_ERROR_STYLE);
+            append(editor->line + i, token->end - i);
+            if (flagged)
+                appendString(EDITOR_RESET_STYLE);
+
+            i = token->end;
+        }
+        else
+        {
+            int end = t < syntax->nTokens ? syntax->tokens[t].start : editor->length;
+            append(editor->line + i, end - i);
+            i = end;
+        }
+    }
+
+    int end = editor->promptWidth + editor->length;
+
+    char hint[MAX_STRING_LENGTH / 4];
+    if (describeSyntax(syntax, editor->line, editor->cursor, hint + 2, sizeof(hint) - 2))
+    {
+        hint[0] = ' ';
+        hint[1] = ' ';
+        appendString(EDITOR_HINT_STYLE);
+        appendString(hint);
+        appendString(EDITOR_RESET_STYLE);
+        end += strlen(hint);
+    }
+
+    // A line ending exactly on the last column leaves the cursor there until the next character, move it to the next row now
+    if (end > editor->promptWidth + from && end % editor->columns == 0)
+        appendString("\r\n");
+
+    appendString("\033[J");
+    editor->screenPos = end;
+    moveTo(editor, editor->promptWidth + editor->cursor);
+    flushOutput();
+}
+
+/**
+ * @brief Redraws after an edit, from the first token whose rendering may have changed.
+ *
+ * Everything after that point has moved on the screen and is redrawn too, so the output of an edit in the middle of the line grows
+ * with the rest of the line. Appending redraws at most the last token and the hint.
+ *
+ * @param editor The editor.
+ * @param position Offset of the edit.
+ */
+static void redrawEdit(LineEditor* editor, int position)
+{
+    SyntaxState* syntax = &editor->syntax;
+    int from = position;
+
+    if (syntax->changedFrom < syntax->nTokens && syntax->tokens[syntax->changedFrom].start < from)
+        from = syntax->tokens[syntax->changedFrom].start;
+
+    redraw(editor, from);
+}
+
+/*-------------------------------Editing----------------------------------*/
+
+// Inserts text at the cursor
+static void insertText(LineEditor* editor, const char* text, int length)
+{
+    if (length > MAX_STRING_LENGTH - 1 - editor->length)
+        length = MAX_STRING_LENGTH - 1 - editor->length;
+    if (length <= 0)
+        return;
+
+    int position = editor->cursor;
+    memmove(editor->line + position + length, editor->line + position, editor->length - position + 1);
+    memcpy(editor->line + position, text, length);
+    editor->length += length;
+    editor->cursor += length;
+
+    syntaxEdit(&editor->syntax, editor->line, editor->length, position, 0, length);
+    redrawEdit(editor, position);
+}
+
+// Deletes text and moves the cursor to where it was
+static void deleteText(LineEditor* editor, int position, int length)
+{
+    if (length <= 0)
+        return;
+
+    memmove(editor->line + position, editor->line + position + length, editor->length - position - length + 1);
+    editor->length -= length;
+    editor->cursor = position;
+
+    syntaxEdit(&editor->syntax, editor->line, editor->length, position, length, 0);
+    redrawEdit(editor, position);
+}
+
+// Moves the cursor, the hint follows it
+static void moveCursor(LineEditor* editor, int position)
+{
+    if (position < 0 || position > editor->length || position == editor->cursor)
+        return;
+
+    editor->cursor = position;
+    redraw(editor, editor->length);
+}
+
+/**
+ * @brief Handles an escape sequence: arrow keys, Home, End and Delete.
+ *
+ * @param editor The editor.
+ */
+static void handleEscape(LineEditor* editor)
+{
+    int first = readByte();
+    int second = readByte();
+
+    if (first == 'O' && second == 'H')
+        moveCursor(editor, 0);
+    else if (first == 'O' && second == 'F')
+        moveCursor(editor, editor->length);
+
+    if (first != '[')
+        return;
+
+    if (second >= '0' && second <= '9')
+    {
+        if (readByte() != '~')
+            return;
+
+        if (second == '3')
+            deleteText(editor, editor->cursor, editor->cursor < editor->length);
+        else if (second == '1' || second == '7')
+            moveCursor(editor, 0);
+        else if (second == '4' || second == '8')
+            moveCursor(editor, editor->length);
+    }
+    else if (second == 'C')
+        moveCursor(editor, editor->cursor + 1);
+    else if (second == 'D')
+        moveCursor(editor, editor->cursor - 1);
+    else if (second == 'H')
+        moveCursor(editor, 0);
+    else if (second == 'F')
+        moveCursor(editor, editor->length);
+}
+
+/**
+ * @brief Moves past the line and its hint, ending the edit.
+ *
+ * @param editor The editor.
+ * @param marker Text written after the line, such as "^C".
+ */
+static void finishLine(LineEditor* editor, const char* marker)
+{
+    editor->columns = terminalColumns();
+    moveTo(editor, editor->promptWidth + editor->length);
+    appendString("\033[J");
+    appendString(marker);
+
+    if (*marker || (editor->promptWidth + editor->length) % editor->columns != 0)
+        appendString("\r\n");
+
+    flushOutput();
+}
+
+/*-------------------------------Public API----------------------------------*/
+
+// Decides whether interactive input goes through the line editor
+void initLineEditor(int enabled)
+{
+    const char* term = getenv("TERM");
+    struct termios attributes;
+
+    editorEnabled = enabled && isatty(STDIN_FD) && isatty(STDOUT_FD) && term && strcmp(term, "dumb") != 0 &&
+                    tcgetattr(STDIN_FD, &attributes) == 0;
+}
+
+// Checks whether interactive input goes through the line editor
+int lineEditorActive()
+{
+    return editorEnabled;
+}
+
+// Prints the prompt and reads a line with the line editor
+char* editLine(const char* prompt)
+{
+    struct termios original, raw;
+    if (tcgetattr(STDIN_FD, &original) == -1)
+        return NULL;
+
+    // No echo, no line buffering, and Ctrl-C, Ctrl-Z and Ctrl-\ arrive as keys while editing
+    raw = original;
+    raw.c_iflag &= ~(ICRNL | IXON);
+    raw.c_lflag &= ~(ECHO | ICANON | ISIG | IEXTEN);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FD, TCSANOW, &raw);
+
+    LineEditor editor;
+    editor.line[0] = '\0';
+    editor.length = 0;
+    editor.cursor = 0;
+    editor.promptWidth = strlen(prompt) + 1;
+    editor.columns = terminalColumns();
+    editor.screenPos = 0;
+    initSyntaxState(&editor.syntax);
+    refreshPathCache();
+
+    // Anything printed with stdio must reach the terminal before the prompt
+    fflush(stdout);
+    appendString(prompt);
+    appendString(" ");
+    editor.screenPos = editor.promptWidth;
+    flushOutput();
+
+    char* result = NULL;
+    int endOfFile = 0;
+    for (;;)
+    {
+        // In low-memory mode, release caches if the shell stays idle. Not while a pasted block is being consumed
+        if (pendingPos == pendingLength)
+            waitForInput();
+
+        int c = readByte();
+        if (c == -1)
+        {
+            // Input closed under the editor, run what was typed so far like fgets() would
+            endOfFile = editor.length == 0;
+            if (!endOfFile)
+            {
+                finishLine(&editor, "");
+                result = strdup(editor.line);
+            }
+            break;
+        }
+
+        if (c >= ' ' && c != KEY_BACKSPACE)
+        {
+            // Take every printable byte already read in one edit, so a paste is lexed and drawn once
+            int start = pendingPos - 1;
+            while (pendingPos < pendingLength && pending[pendingPos] >= ' ' && pending[pendingPos] != KEY_BACKSPACE)
+                pendingPos++;
+
+            insertText(&editor, (const char*)pending + start, pendingPos - start);
+        }
+        else if (c == '\r' || c == '\n')
+        {
+            finishLine(&editor, "");
+            result = strdup(editor.line);
+            break;
+        }
+        else if (c == KEY_CTRL('C'))
+        {
+            finishLine(&editor, "^C");
+            result = strdup("");
+            break;
+        }
+        else if (c == KEY_CTRL('D'))
+        {
+            if (editor.length == 0)
+            {
+                endOfFile = 1;
+                break;
+            }
+            deleteText(&editor, editor.cursor, editor.cursor < editor.length);
+        }
+        else if (c == KEY_BACKSPACE || c == KEY_CTRL('H'))
+        {
+            if (editor.cursor > 0)
+                deleteText(&editor, editor.cursor - 1, 1);
+        }
+        else if (c == KEY_CTRL('A'))
+            moveCursor(&editor, 0);
+        else if (c == KEY_CTRL('E'))
+            moveCursor(&editor, editor.length);
+        else if (c == KEY_CTRL('B'))
+            moveCursor(&editor, editor.cursor - 1);
+        else if (c == KEY_CTRL('F'))
+            moveCursor(&editor, editor.cursor + 1);
+        else if (c == KEY_CTRL('K'))
+            deleteText(&editor, editor.cursor, editor.length - editor.cursor);
+        else if (c == KEY_CTRL('U'))
+            deleteText(&editor, 0, editor.cursor);
+        else if (c == KEY_ESCAPE)
+            handleEscape(&editor);
+    }
+
+    tcsetattr(STDIN_FD, TCSANOW, &original);
+
+    if (endOfFile)
+        return NULL;
+
+    if (!result)
+    {
+        LOG_ERROR("Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return result;
+}
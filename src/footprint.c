@@ -0,0 +1,123 @@
+/**
+ * @file footprint.c
+ * @brief Function definitions for the low-memory mode.
+ * @version 0.1
+ *
+ */
+
+#include "footprint.h"
+#include "shell_builtins.h"
+#include "syntax.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <poll.h>
+#include <stdio.h>
+
+// Global variable to store the shell's state
+extern ShellState* globalShellState;
+
+FootprintConfig footprint;  ///< Active low-memory mode settings
+
+// Initializes the low-memory mode
+void initFootprint(int enabled)
+{
+    footprint.enabled = enabled;
+    footprint.idleTimeoutMs = FOOTPRINT_DEFAULT_IDLE_MS;
+    footprint.released = 0;
+    footprint.idleReleases = 0;
+
+    if (!enabled)
+        return;
+
+    const char* timeout = getenv(FOOTPRINT_IDLE_ENV);
+    if (timeout)
+    {
+        if (strspn(timeout, "0123456789") == strlen(timeout) && strlen(timeout) > 0)
+            footprint.idleTimeoutMs = atoi(timeout) * 1000;
+        else
+            LOG_ERROR("%s: expects a number of seconds\n", FOOTPRINT_IDLE_ENV);
+    }
+
+    // Interactive input is read a line at a time anyway, and an empty stdio buffer means poll() sees all pending input
+    setvbuf(stdin, NULL, _IONBF, 0);
+}
+
+// Waits for interactive input, releasing the caches if the shell stays idle past the timeout
+void waitForInput()
+{
+    if (!footprint.enabled || footprint.released)
+        return;
+
+    struct pollfd pfd = { STDIN_FD, POLLIN, 0 };
+    int ready;
+
+    do {
+        ready = poll(&pfd, 1, footprint.idleTimeoutMs);
+    } while (ready == -1 && errno == EINTR);
+
+    if (ready == 0)
+    {
+        LOG_DEBUG("Idle for %d ms, releasing caches\n", footprint.idleTimeoutMs);
+        releaseIdleMemory();
+        footprint.released = 1;
+        footprint.idleReleases++;
+    }
+}
+
+// Releases the memory the shell can do without between commands
+void trimAfterCommand()
+{
+    if (!footprint.enabled)
+        return;
+
+    footprint.released = 0;
+
+    if (globalShellState->history.nodeCount >= HISTORY_COMPACT_THRESHOLD)
+        compact_history(&globalShellState->history);
+
+    malloc_trim(0);
+}
+
+// Releases every cache that can be rebuilt on demand
+void releaseIdleMemory()
+{
+    compact_history(&globalShellState->history);
+    logTrim();
+    freePathCache();
+    malloc_trim(0);
+}
+
+// Prints the shell's RSS, PSS and history footprint
+int printMemoryUsage()
+{
+    FILE* file = fopen(FOOTPRINT_SMAPS_ROLLUP, "r");
+    if (!file)
+    {
+        LOG_ERROR("memstat: %s: %s\n", FOOTPRINT_SMAPS_ROLLUP, strerror(errno));
+        return -1;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        // Keep the lines that matter for a mostly idle shell
+        if (strncmp(line, "Rss:", 4) == 0 || strncmp(line, "Pss:", 4) == 0 ||
+            strncmp(line, "Private_Clean:", 14) == 0 || strncmp(line, "Private_Dirty:", 14) == 0 ||
+            strncmp(line, "Swap:", 5) == 0)
+        {
+            LOG_PRINT("%s", line);
+        }
+    }
+    fclose(file);
+
+    HistoryList* list = &globalShellState->history;
+    LOG_PRINT("History:          %zu entries, %zu in nodes, %zu archived in %zu kB\n",
+              list->size, list->nodeCount, list->archiveCount, list->archiveMapped / 1024);
+    if (footprint.enabled)
+        LOG_PRINT("Low-memory mode:  on, idle timeout %d s, %lu idle releases\n", footprint.idleTimeoutMs / 1000, footprint.idleReleases);
+    else
+        LOG_PRINT("Low-memory mode:  off\n");
+
+    return 0;
+}
@@ -0,0 +1,512 @@
+/**
+ * @file jobs.c
+ * @brief Function definitions for the background job table and the live job resource monitor.
+ * @version 0.1
+ *
+ */
+
+#include "jobs.h"
+#include "backend.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+
+// Job table
+static Job* jobs = NULL;
+static int nJobs = 0;
+static int nextJobId = 1;
+static int nPidfds = 0;
+
+/**
+ * @brief Resource usage of one process, as read from /proc.
+ */
+typedef struct ProcSample {
+    pid_t pid;                      /**< Process ID */
+    pid_t pgrp;                     /**< Process group */
+    char state;                     /**< Scheduler state (R, S, D, Z, T, ...) */
+    char comm[32];                  /**< Executable name */
+    unsigned long long ticks;       /**< utime + stime, in clock ticks */
+    unsigned long long startTime;   /**< Start time, used to tell a reused pid from the process seen last time */
+    long rssPages;                  /**< Resident set size, in pages */
+    unsigned long long readBytes;   /**< Bytes read (rchar) */
+    unsigned long long writeBytes;  /**< Bytes written (wchar) */
+} ProcSample;
+
+/**
+ * @brief A set of samples taken at the same time.
+ */
+typedef struct SampleSet {
+    ProcSample* samples;  /**< The samples */
+    int n;                /**< Number of samples */
+    int capacity;         /**< Allocated number of samples */
+} SampleSet;
+
+/*-------------------------------Job Table----------------------------------*/
+
+/**
+ * @brief Opens a pidfd for a process.
+ *
+ * @param pid The process.
+ * @return int The pidfd, or -1 if the kernel or the C library doesn't support pidfd_open.
+ */
+static int openPidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+/**
+ * @brief Checks whether a process of a job has exited.
+ *
+ * A pidfd becomes readable when its process exits. Without a pidfd, either unsupported, over JOBS_MAX_PIDFDS or for a simulated
+ * process, ask the backend.
+ *
+ * @param job The job.
+ * @param i Index of the process in the job.
+ * @return int 1 if the process has exited, 0 otherwise.
+ */
+static int processExited(Job* job, int i)
+{
+    if (job->pidfds[i] != -1)
+    {
+        struct pollfd pfd = { job->pidfds[i], POLLIN, 0 };
+        return poll(&pfd, 1, 0) == 1;
+    }
+
+    return !execBackend->alive(job->pids[i]);
+}
+
+/**
+ * @brief Checks whether any process of a job is still running.
+ *
+ * @param job The job.
+ * @return int 1 if the job is running, 0 if all its processes have exited.
+ */
+static int jobRunning(Job* job)
+{
+    for (int i = 0; i < job->nPids; i++)
+    {
+        if (!processExited(job, i))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees the resources of a job.
+ *
+ * @param job The job.
+ */
+static void cleanUpJob(Job* job)
+{
+    for (int i = 0; i < job->nPids; i++)
+    {
+        if (job->pidfds[i] != -1)
+        {
+            close(job->pidfds[i]);
+            nPidfds--;
+        }
+    }
+
+    free(job->pids);
+    free(job->pidfds);
+    free(job->commandLine);
+}
+
+/**
+ * @brief Forgets the jobs whose processes have all exited.
+ */
+static void removeFinishedJobs()
+{
+    int kept = 0;
+    for (int i = 0; i < nJobs; i++)
+    {
+        if (jobRunning(&jobs[i]))
+            jobs[kept++] = jobs[i];
+        else
+            cleanUpJob(&jobs[i]);
+    }
+    nJobs = kept;
+
+    if (nJobs == 0)
+        nextJobId = 1;
+}
+
+// Adds a background command that was just started to the job table
+int addJob(Command* command)
+{
+    // Finished jobs would otherwise keep their pidfds until the next `jobs`
+    removeFinishedJobs();
+
+    Job job;
+    job.nPids = 0;
+    job.pids = malloc(sizeof(pid_t) * command->nSimpleCommands);
+    job.pidfds = malloc(sizeof(int) * command->nSimpleCommands);
+    job.commandLine = malloc(MAX_STRING_LENGTH);
+
+    if (!job.pids || !job.pidfds || !job.commandLine)
+    {
+        free(job.pids);
+        free(job.pidfds);
+        free(job.commandLine);
+        return -1;
+    }
+
+    // Rebuild the command line from the parsed arguments
+    size_t length = 0;
+    job.commandLine[0] = '\0';
+    for (int i = 0; i < command->nSimpleCommands; i++)
+    {
+        SimpleCommand* simpleCommand = command->simpleCommands[i];
+
+        for (int j = 0; j < simpleCommand->argc && length < MAX_STRING_LENGTH; j++)
+            length += snprintf(job.commandLine + length, MAX_STRING_LENGTH - length, "%s%s", (i || j) ? (j ? " " : " | ") : "", simpleCommand->args[j]);
+
+        // Builtins run in the shell itself and have no process to track
+        if (simpleCommand->pid > 0)
+        {
+            job.pids[job.nPids] = simpleCommand->pid;
+            // Only real processes have a pidfd
+            job.pidfds[job.nPids] = (execBackend == &linuxBackend && nPidfds < JOBS_MAX_PIDFDS) ? openPidfd(simpleCommand->pid) : -1;
+            if (job.pidfds[job.nPids] != -1)
+                nPidfds++;
+            job.nPids++;
+        }
+    }
+
+    Job* temp = realloc(jobs, sizeof(Job) * (nJobs + 1));
+    if (job.nPids == 0 || !temp)
+    {
+        if (temp)
+            jobs = temp;
+        cleanUpJob(&job);
+        return -1;
+    }
+
+    jobs = temp;
+    job.id = nextJobId++;
+    job.pgid = job.pids[0];
+    jobs[nJobs++] = job;
+
+    LOG_DEBUG("Job [%d] started, pgid %d\n", job.id, job.pgid);
+    return job.id;
+}
+
+// Frees the job table
+void cleanUpJobs()
+{
+    for (int i = 0; i < nJobs; i++)
+        cleanUpJob(&jobs[i]);
+
+    free(jobs);
+    jobs = NULL;
+    nJobs = 0;
+}
+
+/*-------------------------------Sampling----------------------------------*/
+
+/**
+ * @brief Checks whether a process group belongs to a job.
+ *
+ * @param pgrp The process group.
+ * @return int 1 if a job runs in that group, 0 otherwise.
+ */
+static int isJobGroup(pid_t pgrp)
+{
+    for (int i = 0; i < nJobs; i++)
+    {
+        if (jobs[i].pgid == pgrp)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads the resource usage of a process that belongs to a job.
+ *
+ * The process group is checked as soon as /proc/<pid>/stat is parsed, so that /proc/<pid>/io is only read for the jobs' processes.
+ *
+ * @param pid The process.
+ * @param sample The sample to fill.
+ * @return int 0 on success, -1 if the process is gone, unreadable or not part of a job.
+ */
+static int readProcSample(pid_t pid, ProcSample* sample)
+{
+    char path[64];
+    char buffer[1024];
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return -1;
+
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+    fclose(file);
+    buffer[length] = '\0';
+
+    // The executable name is in parentheses and may itself contain spaces or parentheses, so parse from the last ')'
+    char* open = strchr(buffer, '(');
+    char* close = strrchr(buffer, ')');
+    if (!open || !close || close < open)
+        return -1;
+
+    size_t commLength = close - open - 1;
+    if (commLength >= sizeof(sample->comm))
+        commLength = sizeof(sample->comm) - 1;
+    memcpy(sample->comm, open + 1, commLength);
+    sample->comm[commLength] = '\0';
+
+    unsigned long long utime, stime;
+    int pgrp;
+    if (sscanf(close + 2, "%c %*d %d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %*d %*d %llu %*u %ld",
+               &sample->state, &pgrp, &utime, &stime, &sample->startTime, &sample->rssPages) != 6)
+        return -1;
+
+    if (!isJobGroup(pgrp))
+        return -1;
+
+    sample->pid = pid;
+    sample->pgrp = pgrp;
+    sample->ticks = utime + stime;
+    sample->readBytes = 0;
+    sample->writeBytes = 0;
+
+    // I/O counters, unreadable for processes we don't own
+    snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+    file = fopen(path, "r");
+    if (file)
+    {
+        while (fgets(buffer, sizeof(buffer), file))
+        {
+            if (sscanf(buffer, "rchar: %llu", &sample->readBytes) == 1)
+                continue;
+            sscanf(buffer, "wchar: %llu", &sample->writeBytes);
+        }
+        fclose(file);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Samples every process that belongs to a job's process group.
+ *
+ * Walks /proc, so that processes started by the job's own processes are included.
+ *
+ * @param set The sample set to fill, its previous content is discarded.
+ * @return int 0 on success, -1 if /proc can't be read.
+ */
+static int collectSamples(SampleSet* set)
+{
+    set->n = 0;
+
+    DIR* proc = opendir("/proc");
+    if (!proc)
+        return -1;
+
+    struct dirent* entry;
+    while ((entry = readdir(proc)) != NULL)
+    {
+        if (!isdigit((unsigned char)entry->d_name[0]))
+            continue;
+
+        if (set->n == set->capacity)
+        {
+            int capacity = set->capacity ? set->capacity * 2 : 16;
+            ProcSample* temp = realloc(set->samples, sizeof(ProcSample) * capacity);
+            if (!temp)
+                break;
+            set->samples = temp;
+            set->capacity = capacity;
+        }
+
+        ProcSample* sample = &set->samples[set->n];
+        if (readProcSample((pid_t)atoi(entry->d_name), sample) == 0)
+            set->n++;
+    }
+
+    closedir(proc);
+    return 0;
+}
+
+/**
+ * @brief Finds the previous sample of the same process.
+ *
+ * @param set The previous samples.
+ * @param sample The current sample.
+ * @return ProcSample* The previous sample, or NULL if the process is new.
+ */
+static ProcSample* findSample(SampleSet* set, ProcSample* sample)
+{
+    for (int i = 0; i < set->n; i++)
+    {
+        if (set->samples[i].pid == sample->pid && set->samples[i].startTime == sample->startTime)
+            return &set->samples[i];
+    }
+    return NULL;
+}
+
+/*-------------------------------Display----------------------------------*/
+
+/**
+ * @brief Prints one line per job, and optionally its processes' resource usage.
+ *
+ * @param current The current samples, or NULL for the plain job list.
+ * @param previous The samples of the previous tick, used for CPU usage.
+ * @param elapsedTicks Clock ticks elapsed between the two samples.
+ */
+static void printJobTable(SampleSet* current, SampleSet* previous, double elapsedTicks)
+{
+    long pageKB = sysconf(_SC_PAGESIZE) / 1024;
+
+    if (current)
+        LOG_PRINT("%-6s %-8s %-2s %6s %10s %10s %10s  %s\n", "JOB", "PID", "S", "CPU%", "RSS(kB)", "READ(kB)", "WRITE(kB)", "COMMAND");
+
+    for (int i = 0; i < nJobs; i++)
+    {
+        Job* job = &jobs[i];
+        char label[16];
+        snprintf(label, sizeof(label), "[%d]", job->id);
+        LOG_PRINT("%-6s %-8d %-7s %s\n", label, (int)job->pgid, jobRunning(job) ? "Running" : "Done", job->commandLine);
+
+        if (!current)
+            continue;
+
+        for (int j = 0; j < current->n; j++)
+        {
+            ProcSample* sample = &current->samples[j];
+            if (sample->pgrp != job->pgid)
+                continue;
+
+            ProcSample* before = previous ? findSample(previous, sample) : NULL;
+            double cpu = (before && elapsedTicks > 0) ? 100.0 * (sample->ticks - before->ticks) / elapsedTicks : 0;
+
+            LOG_PRINT("%-6s %-8d %-2c %6.1f %10ld %10llu %10llu  %s\n", "", (int)sample->pid, sample->state, cpu,
+                      sample->rssPages * pageKB, sample->readBytes / 1024, sample->writeBytes / 1024, sample->comm);
+        }
+    }
+}
+
+/**
+ * @brief Samples the jobs on a timerfd cadence and prints the table on every tick.
+ *
+ * @param intervalMs Sampling interval in milliseconds.
+ * @param count Number of ticks to print, 0 for no limit.
+ * @param live Whether to redraw the screen and stop on Enter.
+ * @return int 0 on success, -1 on failure.
+ */
+static int monitorJobs(int intervalMs, int count, int live)
+{
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer == -1)
+    {
+        LOG_ERROR("timerfd_create: %s\n", strerror(errno));
+        return -1;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = intervalMs / 1000;
+    spec.it_interval.tv_nsec = (intervalMs % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(timer, 0, &spec, NULL);
+
+    SampleSet sets[2] = { { NULL, 0, 0 }, { NULL, 0, 0 } };
+    SampleSet* previous = &sets[0];
+    SampleSet* current = &sets[1];
+    double ticksPerInterval = sysconf(_SC_CLK_TCK) * (intervalMs / 1000.0);
+    int watchInput = live && isatty(STDIN_FD);
+    int status = 0;
+
+    collectSamples(previous);
+
+    for (int shown = 0; count == 0 || shown < count; )
+    {
+        struct pollfd fds[2] = { { timer, POLLIN, 0 }, { STDIN_FD, POLLIN, 0 } };
+        if (poll(fds, watchInput ? 2 : 1, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;  // SIGCHLD from a finishing job
+            status = -1;
+            break;
+        }
+
+        if (watchInput && (fds[1].revents & POLLIN))
+        {
+            // Consume the line that ended the view
+            char line[MAX_STRING_LENGTH];
+            if (!fgets(line, sizeof(line), stdin))
+                clearerr(stdin);
+            break;
+        }
+
+        if (!(fds[0].revents & POLLIN))
+            continue;
+
+        uint64_t expirations;
+        if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations))
+            continue;
+
+        collectSamples(current);
+
+        if (live && isatty(STDOUT_FD))
+            LOG_PRINT("\033[H\033[2J");
+        printJobTable(current, previous, ticksPerInterval * expirations);
+        if (live)
+            LOG_PRINT("\n%d job(s), sampling every %d ms. Press Enter to leave.\n", nJobs, intervalMs);
+        fflush(stdout);
+        shown++;
+
+        SampleSet* swap = previous;
+        previous = current;
+        current = swap;
+
+        if (live && current->n == 0 && previous->n == 0)
+            break;  // Nothing left to watch
+    }
+
+    close(timer);
+    free(sets[0].samples);
+    free(sets[1].samples);
+    return status;
+}
+
+/*-------------------------------Builtin Entry Points----------------------------------*/
+
+// Prints the job table, then forgets the jobs that have finished
+int printJobs(int verbose)
+{
+    int status = 0;
+
+    if (verbose && nJobs > 0)
+        status = monitorJobs(JOBS_VERBOSE_INTERVAL_MS, 1, 0);
+    else
+        printJobTable(NULL, NULL, 0);
+
+    removeFinishedJobs();
+    return status;
+}
+
+// Runs the live job resource monitor
+int runJobTop(int intervalMs, int count)
+{
+    if (nJobs == 0)
+    {
+        LOG_PRINT("No jobs\n");
+        return 0;
+    }
+
+    int status = monitorJobs(intervalMs, count, 1);
+    removeFinishedJobs();
+    return status;
+}
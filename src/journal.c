@@ -0,0 +1,165 @@
+/**
+ * @file journal.c
+ * @brief Function definitions for the script execution journal.
+ * @version 0.1
+ *
+ * Each record is a text line "<line> <hash> <status>", the hash being the 64-bit FNV-1a hash of the script line in hexadecimal.
+ * Lines starting with '#' mark the start of a run and are ignored when loading.
+ *
+ */
+
+#include "journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/**
+ * @brief Hashes a script line with 64-bit FNV-1a.
+ *
+ * Zero is reserved for "no success recorded", so a line hashing to zero is mapped to one.
+ *
+ * @param input The line.
+ * @return uint64_t The hash.
+ */
+static uint64_t hashLine(const char* input)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char* c = (const unsigned char*)input; *c; c++)
+    {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash ? hash : 1;
+}
+
+/**
+ * @brief Records the hash of a successful line in the table, growing it if needed.
+ *
+ * @param journal The journal.
+ * @param lineNumber The line number.
+ * @param hash The line's hash, or 0 to forget a previous success.
+ * @return int 0 on success, -1 on allocation failure.
+ */
+static int setSucceeded(Journal* journal, int lineNumber, uint64_t hash)
+{
+    if (lineNumber >= journal->nLines)
+    {
+        int nLines = journal->nLines ? journal->nLines : 64;
+        while (nLines <= lineNumber)
+            nLines *= 2;
+
+        uint64_t* temp = realloc(journal->succeeded, nLines * sizeof(uint64_t));
+        if (!temp)
+            return -1;
+
+        memset(temp + journal->nLines, 0, (nLines - journal->nLines) * sizeof(uint64_t));
+        journal->succeeded = temp;
+        journal->nLines = nLines;
+    }
+
+    journal->succeeded[lineNumber] = hash;
+    return 0;
+}
+
+/**
+ * @brief Loads the successes recorded by previous runs.
+ *
+ * Later records override earlier ones, so a line that succeeded and then failed in a later run is not skipped.
+ *
+ * @param journal The journal.
+ * @param path Path to the journal file.
+ * @return int 0 on success or if the journal doesn't exist yet, -1 on failure.
+ */
+static int loadJournal(Journal* journal, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return errno == ENOENT ? 0 : -1;
+
+    char line[128];
+    while (fgets(line, sizeof(line), file))
+    {
+        int lineNumber, status;
+        uint64_t hash;
+
+        if (line[0] == '#' || sscanf(line, "%d %" SCNx64 " %d", &lineNumber, &hash, &status) != 3 || lineNumber < 1)
+            continue;
+
+        if (setSucceeded(journal, lineNumber, status == 0 ? hash : 0) != 0)
+        {
+            fclose(file);
+            return -1;
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+// Opens the journal of a script run
+int openJournal(Journal* journal, const char* path, int resume)
+{
+    journal->fd = -1;
+    journal->succeeded = NULL;
+    journal->nLines = 0;
+    journal->skipped = 0;
+
+    if (resume && loadJournal(journal, path) != 0)
+    {
+        LOG_ERROR("Error reading journal %s: %s\n", path, strerror(errno));
+        closeJournal(journal);
+        return -1;
+    }
+
+    journal->fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC | (resume ? O_APPEND : O_TRUNC), 0644);
+    if (journal->fd == -1)
+    {
+        LOG_ERROR("Error opening journal %s: %s\n", path, strerror(errno));
+        closeJournal(journal);
+        return -1;
+    }
+
+    dprintf(journal->fd, "# %s run, pid %d\n", resume ? "resumed" : "fresh", (int)getpid());
+    return 0;
+}
+
+// Checks whether a script line succeeded in a previous run and can be skipped
+int journalShouldSkip(Journal* journal, int lineNumber, const char* input)
+{
+    if (journal->fd == -1 || lineNumber >= journal->nLines || journal->succeeded[lineNumber] == 0)
+        return 0;
+
+    if (journal->succeeded[lineNumber] != hashLine(input))
+        return 0;
+
+    journal->skipped++;
+    return 1;
+}
+
+// Records a completed top-level command
+void journalRecord(Journal* journal, int lineNumber, const char* input, int status)
+{
+    if (journal->fd == -1)
+        return;
+
+    // One write() per record, so a crash never leaves half a record behind that a resumed run would trust
+    char record[64];
+    int length = snprintf(record, sizeof(record), "%d %016" PRIx64 " %d\n", lineNumber, hashLine(input), status);
+    if (write(journal->fd, record, length) != length)
+        LOG_DEBUG("Short write to the journal: %s\n", strerror(errno));
+}
+
+// Closes the journal and frees its table
+void closeJournal(Journal* journal)
+{
+    if (journal->fd != -1)
+        close(journal->fd);
+
+    free(journal->succeeded);
+    journal->fd = -1;
+    journal->succeeded = NULL;
+    journal->nLines = 0;
+}
@@ -0,0 +1,496 @@
+/**
+ * @file log.c
+ * @brief Function definitions for the runtime log levels, the log sinks and the asynchronous writer.
+ * @version 0.1
+ *
+ */
+
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+int logLevel = LOG_DEFAULT_LEVEL;  ///< Current runtime log level
+
+/**
+ * @brief A diagnostic waiting in the ring for the writer thread.
+ *
+ * Only the message body is formatted by the caller. The prefix, annotations and timestamp are added by the writer.
+ */
+typedef struct LogRecord {
+    int type;                        /**< LOG_ERR or LOG_DBG */
+    int annotate;                    /**< Whether the level was debug when the record was queued */
+    const char* prefix;              /**< Static prefix string, e.g. "[ERROR]" */
+    const char* color;               /**< Static color escape sequence */
+    const char* file;                /**< Source file of the call site */
+    const char* func;                /**< Function of the call site */
+    int line;                        /**< Line of the call site */
+    struct timespec time;            /**< Wall clock time at which the record was queued */
+    char text[LOG_RECORD_LENGTH];    /**< The formatted message body */
+} LogRecord;
+
+// Sink state
+static int sinkType = LOG_SINK_STDERR;
+static int sinkFD = -1;             // -1 means the current STDERR_FD
+static int sinkIsTTY = 0;
+static char sinkSpec[LOG_RECORD_LENGTH] = "stderr";
+
+// Ring shared with the writer thread, guarded by ringLock. Allocated on first use and released by logTrim().
+static LogRecord* ring = NULL;
+static int ringHead = 0;
+static int ringCount = 0;
+static int writerBusy = 0;
+static int writerStopping = 0;
+static int writerRunning = 0;
+static int writerParked = 0;        // Stopped by logTrim(), started again by the next diagnostic
+static int forkedChild = 0;
+static pthread_t writerThread;
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ringNotEmpty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ringDrained = PTHREAD_COND_INITIALIZER;
+
+// Counters
+static unsigned long queuedRecords = 0;
+static unsigned long syncRecords = 0;
+
+// Set while the main thread is inside logWrite, so that a signal handler logging at the same time doesn't deadlock on ringLock
+static volatile sig_atomic_t inLogWrite = 0;
+
+// Number of signal handlers running, whose diagnostics are written synchronously
+static volatile sig_atomic_t signalDepth = 0;
+
+/*-------------------------------Sink Output----------------------------------*/
+
+/**
+ * @brief Writes a buffer to a file descriptor, retrying on partial writes and interruptions.
+ *
+ * @param fd The file descriptor.
+ * @param buffer The data to write.
+ * @param length The number of bytes to write.
+ */
+static void writeAll(int fd, const char* buffer, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, buffer, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        buffer += written;
+        length -= written;
+    }
+}
+
+/**
+ * @brief Decorates a record according to the sink and writes it.
+ *
+ * In a forked child, the stderr sink is the child's own (possibly redirected) stderr.
+ *
+ * @param record The record to write.
+ */
+static void emitRecord(const LogRecord* record)
+{
+    char out[LOG_RECORD_LENGTH + 256];
+    int length = 0;
+    int fd = (sinkFD == -1 || (forkedChild && sinkType == LOG_SINK_STDERR)) ? STDERR_FILENO : sinkFD;
+
+    if (sinkType == LOG_SINK_SYSLOG)
+    {
+        // RFC 3164 style message: facility user (1), severity err (3) or debug (7)
+        int priority = 8 + (record->type == LOG_ERR ? 3 : 7);
+        length = snprintf(out, sizeof(out), "<%d>%s[%d]: %s", priority, LOG_IDENT, (int)getpid(), record->text);
+    }
+    else
+    {
+        if (sinkType == LOG_SINK_FILE)
+        {
+            struct tm tm;
+            localtime_r(&record->time.tv_sec, &tm);
+            length += strftime(out, sizeof(out), "%Y-%m-%dT%H:%M:%S", &tm);
+            length += snprintf(out + length, sizeof(out) - length, ".%03ld [%d] %s ",
+                               record->time.tv_nsec / 1000000L, (int)getpid(), record->prefix);
+        }
+        else if (record->annotate)
+        {
+            if (sinkIsTTY)
+                length += snprintf(out, sizeof(out), "%s%s%s: ", record->color, record->prefix, LOG_RESET);
+            else
+                length += snprintf(out, sizeof(out), "%s: ", record->prefix);
+        }
+
+        if (record->annotate && ANNOTATIONS_INFO)
+        {
+            length += snprintf(out + length, sizeof(out) - length, "(");
+            if (ANNOTATIONS_FILE) length += snprintf(out + length, sizeof(out) - length, "%s", record->file);
+            if (ANNOTATIONS_FILE && ANNOTATIONS_FUNC) length += snprintf(out + length, sizeof(out) - length, ",");
+            if (ANNOTATIONS_FUNC) length += snprintf(out + length, sizeof(out) - length, "%s", record->func);
+            if (ANNOTATIONS_FUNC && ANNOTATIONS_LINE) length += snprintf(out + length, sizeof(out) - length, ",");
+            if (ANNOTATIONS_LINE) length += snprintf(out + length, sizeof(out) - length, "%d", record->line);
+            length += snprintf(out + length, sizeof(out) - length, ") ");
+        }
+
+        length += snprintf(out + length, sizeof(out) - length, "%s", record->text);
+    }
+
+    if (length >= (int)sizeof(out))
+        length = sizeof(out) - 1;
+
+    // Files and syslog get one diagnostic per line
+    if (sinkType != LOG_SINK_STDERR && length > 0 && out[length - 1] != '\n' && length < (int)sizeof(out) - 1)
+        out[length++] = '\n';
+
+    if (sinkType == LOG_SINK_SYSLOG)
+        send(fd, out, length, MSG_NOSIGNAL);
+    else
+        writeAll(fd, out, length);
+}
+
+/*-------------------------------Writer Thread----------------------------------*/
+
+/**
+ * @brief Main loop of the writer thread.
+ *
+ * Takes records off the ring one at a time and writes them with the lock released, so producers are never blocked on I/O.
+ *
+ * @param arg Unused.
+ * @return void* Always NULL.
+ */
+static void* writerMain(void* arg)
+{
+    (void)arg;
+    LogRecord record;
+
+    pthread_mutex_lock(&ringLock);
+    while (1)
+    {
+        while (ringCount == 0 && !writerStopping)
+            pthread_cond_wait(&ringNotEmpty, &ringLock);
+
+        if (ringCount == 0)
+            break;
+
+        record = ring[ringHead];
+        ringHead = (ringHead + 1) % LOG_RING_SLOTS;
+        ringCount--;
+        writerBusy = 1;
+        pthread_mutex_unlock(&ringLock);
+
+        emitRecord(&record);
+
+        pthread_mutex_lock(&ringLock);
+        writerBusy = 0;
+        if (ringCount == 0)
+            pthread_cond_broadcast(&ringDrained);
+    }
+    pthread_mutex_unlock(&ringLock);
+
+    return NULL;
+}
+
+/**
+ * @brief Starts the writer thread.
+ *
+ * The writer inherits a fully blocked signal mask, so that SIGCHLD and the terminal signals are always handled by the main thread.
+ *
+ * @return int 0 on success, -1 if the thread couldn't be created.
+ */
+static int startWriter()
+{
+    // A writer stopped by logTrim() left the flag set, the new thread would exit at once if it saw it
+    pthread_mutex_lock(&ringLock);
+    writerStopping = 0;
+    pthread_mutex_unlock(&ringLock);
+
+    sigset_t allSignals, oldMask;
+    sigfillset(&allSignals);
+    pthread_sigmask(SIG_SETMASK, &allSignals, &oldMask);
+    int created = pthread_create(&writerThread, NULL, writerMain, NULL);
+    pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+
+    if (created != 0)
+        return -1;
+
+    writerRunning = 1;
+    return 0;
+}
+
+/**
+ * @brief Stops the writer thread after it has drained the ring. Registered with atexit().
+ */
+static void stopWriter()
+{
+    if (!writerRunning)
+        return;
+
+    pthread_mutex_lock(&ringLock);
+    writerStopping = 1;
+    pthread_cond_signal(&ringNotEmpty);
+    pthread_mutex_unlock(&ringLock);
+
+    pthread_join(writerThread, NULL);
+    writerRunning = 0;
+}
+
+// Fork handlers: hold the lock across fork() so the child never inherits it locked
+static void forkPrepare() { pthread_mutex_lock(&ringLock); }
+static void forkParent()  { pthread_mutex_unlock(&ringLock); }
+
+/**
+ * @brief Fork handler run in the child.
+ *
+ * The writer thread doesn't exist in the child, so the child writes synchronously. Records queued by the parent are left to the parent.
+ */
+static void forkChild()
+{
+    pthread_mutex_init(&ringLock, NULL);
+    writerRunning = 0;
+    writerParked = 0;
+    forkedChild = 1;
+    ringCount = 0;
+    writerBusy = 0;
+}
+
+/*-------------------------------Public Interface----------------------------------*/
+
+// Queues a diagnostic for the writer thread
+void logWrite(int type, const char* prefix, const char* color, const char* file, const char* func, int line, const char* format, ...)
+{
+    LogRecord local;
+    LogRecord* record = &local;
+    int savedErrno = errno;
+    int queued = 0;
+    // Inside a signal handler, neither the lock, the ring allocation nor pthread_create() can be used safely
+    int reentrant = inLogWrite || signalDepth > 0;
+
+    if (writerParked && !reentrant)
+    {
+        // If the thread can't be created again, the records are written synchronously
+        writerParked = 0;
+        startWriter();
+    }
+
+    if (writerRunning && !reentrant)
+    {
+        inLogWrite = 1;
+        pthread_mutex_lock(&ringLock);
+        if (!ring)
+            ring = malloc(sizeof(LogRecord) * LOG_RING_SLOTS);
+
+        if (ring && ringCount < LOG_RING_SLOTS)
+        {
+            record = &ring[(ringHead + ringCount) % LOG_RING_SLOTS];
+            queued = 1;
+        }
+    }
+
+    record->type = type;
+    record->annotate = (logLevel >= LOG_LEVEL_DEBUG);
+    record->prefix = prefix;
+    record->color = color;
+    record->file = file;
+    record->func = func;
+    record->line = line;
+    if (sinkType == LOG_SINK_FILE)
+        clock_gettime(CLOCK_REALTIME, &record->time);
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(record->text, LOG_RECORD_LENGTH, format, args);
+    va_end(args);
+
+    if (queued)
+    {
+        ringCount++;
+        queuedRecords++;
+        pthread_cond_signal(&ringNotEmpty);
+    }
+
+    if (writerRunning && !reentrant)
+    {
+        pthread_mutex_unlock(&ringLock);
+        inLogWrite = 0;
+    }
+
+    if (!queued)
+    {
+        // No writer, ring full, or called from a signal handler: write it ourselves rather than lose it
+        syncRecords++;
+        emitRecord(record);
+    }
+
+    errno = savedErrno;
+}
+
+// Initializes logging from the environment and starts the writer thread
+int initLogging()
+{
+    int status = 0;
+
+    const char* level = getenv(LOG_LEVEL_ENV);
+    if (level && setLogLevel(level) != 0)
+        status = -1;
+
+    const char* sink = getenv(LOG_SINK_ENV);
+    if (sink && setLogSink(sink) != 0)
+        status = -1;
+
+    if (sinkType == LOG_SINK_STDERR && sinkFD == -1)
+    {
+        // Keep writing to the shell's own stderr even while a builtin has it redirected
+        sinkFD = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 3);
+        sinkIsTTY = isatty(STDERR_FILENO);
+    }
+
+    if (startWriter() != 0)
+        return -1;
+
+    pthread_atfork(forkPrepare, forkParent, forkChild);
+    atexit(stopWriter);
+
+    return status;
+}
+
+// Marks the start or the end of a signal handler that may log
+void logSignalHandler(int entering)
+{
+    if (entering)
+        signalDepth++;
+    else
+        signalDepth--;
+}
+
+// Blocks until every queued diagnostic has been written
+void logFlush()
+{
+    if (!writerRunning)
+        return;
+
+    inLogWrite = 1;
+    pthread_mutex_lock(&ringLock);
+    while (ringCount > 0 || writerBusy)
+        pthread_cond_wait(&ringDrained, &ringLock);
+    pthread_mutex_unlock(&ringLock);
+    inLogWrite = 0;
+}
+
+// Stops the writer and releases its ring while nothing is queued
+void logTrim()
+{
+    if (!writerRunning)
+        return;
+
+    inLogWrite = 1;
+    pthread_mutex_lock(&ringLock);
+    int idle = (ringCount == 0 && !writerBusy);
+    pthread_mutex_unlock(&ringLock);
+    inLogWrite = 0;
+
+    if (!idle)
+        return;
+
+    // The main thread is the only producer, so nothing can be queued while the writer exits
+    stopWriter();
+    writerParked = 1;
+    free(ring);
+    ring = NULL;
+    ringHead = 0;
+}
+
+// Sets the runtime log level from its name
+int setLogLevel(const char* name)
+{
+    if (strcmp(name, "off") == 0)
+        logLevel = LOG_LEVEL_OFF;
+    else if (strcmp(name, "error") == 0)
+        logLevel = LOG_LEVEL_ERROR;
+    else if (strcmp(name, "debug") == 0)
+        logLevel = LOG_LEVEL_DEBUG;
+    else
+    {
+        logWrite(LOG_ERR, "[ERROR]", LOG_COLOR_ERR, __FILE__, __func__, __LINE__, "log: unknown level '%s'\n", name);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Switches the log sink
+int setLogSink(const char* spec)
+{
+    int type;
+    int fd;
+
+    if (strcmp(spec, "stderr") == 0)
+    {
+        type = LOG_SINK_STDERR;
+        fd = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 3);
+    }
+    else if (strncmp(spec, "file:", 5) == 0 && spec[5] != '\0')
+    {
+        type = LOG_SINK_FILE;
+        fd = open(spec + 5, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+    else if (strcmp(spec, "syslog") == 0 || (strncmp(spec, "syslog:", 7) == 0 && spec[7] != '\0'))
+    {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, spec[6] == ':' ? spec + 7 : LOG_SYSLOG_SOCKET, sizeof(address.sun_path) - 1);
+
+        type = LOG_SINK_SYSLOG;
+        fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd != -1 && connect(fd, (struct sockaddr*)&address, sizeof(address)) == -1)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    else
+    {
+        logWrite(LOG_ERR, "[ERROR]", LOG_COLOR_ERR, __FILE__, __func__, __LINE__, "log: invalid sink '%s'\n", spec);
+        return -1;
+    }
+
+    if (fd == -1)
+    {
+        logWrite(LOG_ERR, "[ERROR]", LOG_COLOR_ERR, __FILE__, __func__, __LINE__, "log: %s: %s\n", spec, strerror(errno));
+        return -1;
+    }
+
+    // The shell is single threaded apart from the writer, so nothing can be queued between the flush and the switch
+    logFlush();
+
+    if (sinkFD != -1)
+        close(sinkFD);
+
+    sinkType = type;
+    sinkFD = fd;
+    sinkIsTTY = isatty(fd);
+    strncpy(sinkSpec, spec, sizeof(sinkSpec) - 1);
+
+    return 0;
+}
+
+// Prints the current log level, sink and writer counters to stdout
+void printLogStatus()
+{
+    const char* level = logLevel == LOG_LEVEL_OFF ? "off" : (logLevel == LOG_LEVEL_ERROR ? "error" : "debug");
+
+    LOG_OUT("level   %s\n", level);
+    LOG_OUT("sink    %s\n", sinkSpec);
+    LOG_OUT("writer  %s\n", writerRunning ? "async" : (writerParked ? "idle" : "sync"));
+    LOG_OUT("queued  %lu\n", queuedRecords);
+    LOG_OUT("sync    %lu\n", syncRecords);
+}
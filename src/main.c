@@ -2,6 +2,13 @@
 #include "command.h"
 #include "parser.h"
 #include "shell_builtins.h"
+#include "spawn.h"
+#include "startup.h"
+#include "footprint.h"
+#include "journal.h"
+#include "jobs.h"
+#include "backend.h"
+#include "editor.h"
 
 #include <errno.h>
 #include <signal.h>
@@ -15,6 +22,8 @@ ShellState* globalShellState; ///< Holds the state of the shell, including histo
 
 FILE* scriptFile; ///< File pointer for reading script files in non-interactive mode
 
+int scriptLineNumber = 0; ///< Line number of the last line read from the script
+
 /**
  * @brief Reads input from either the terminal or a script file.
  * 
@@ -23,39 +32,48 @@ FILE* scriptFile; ///< File pointer for reading script files in non-interactive
  */
 char* getInput(int interactive)
 {
-    char* input = malloc(MAX_STRING_LENGTH);  ///< Allocate memory for input buffer
-    if (input == NULL) {
-        LOG_ERROR("Memory allocation failed");
-        exit(EXIT_FAILURE);  ///< Exit if memory allocation fails
-    }
+    char* input = NULL;  ///< Returned input, sized to the line
 
-    if (interactive)
+    if (interactive && lineEditorActive())
+    {
+        logFlush();  ///< Let diagnostics of the previous command appear before the prompt
+        return editLine(globalShellState->prompt_buffer);  ///< NULL at end of file (Ctrl-D)
+    }
+    else if (interactive)
     {
         int again = 1;
         char *linept;  ///< Pointer to the line buffer
+        char buffer[MAX_STRING_LENGTH];  ///< Line buffer, on the stack so an idle shell holds no heap memory for it
 
         while (again) {
             again = 0;
+            logFlush();  ///< Let diagnostics of the previous command appear before the prompt
             printf("%s ", globalShellState->prompt_buffer);  ///< Print prompt
-            linept = fgets(input, MAX_STRING_LENGTH, stdin);  ///< Read input from stdin
+            fflush(stdout);
+            waitForInput();  ///< In low-memory mode, release caches if the shell stays idle
+            linept = fgets(buffer, MAX_STRING_LENGTH, stdin);  ///< Read input from stdin
             if (linept == NULL) {
                 if (feof(stdin)) {
-                    free(input);
                     return NULL;  ///< End of file (Ctrl-D)
                 } else if (errno == EINTR) {
                     again = 1;  ///< Signal interruption, read again
                 } else {
                     LOG_ERROR("Error reading input: %s\n", strerror(errno));
-                    free(input);
                     exit(EXIT_FAILURE);  ///< Exit on read error
                 }
             }
         }
 
         // Remove the trailing newline character from input
-        size_t ln = strlen(input);
-        if (ln > 0 && input[ln - 1] == '\n') {
-            input[ln - 1] = '\0';
+        size_t ln = strlen(buffer);
+        if (ln > 0 && buffer[ln - 1] == '\n') {
+            buffer[ln - 1] = '\0';
+        }
+
+        input = strdup(buffer);
+        if (input == NULL) {
+            LOG_ERROR("Memory allocation failed");
+            exit(EXIT_FAILURE);  ///< Exit if memory allocation fails
         }
     }
     else
@@ -66,6 +84,7 @@ char* getInput(int interactive)
             free(input);
             return NULL;  ///< End of file (script ended)
         }
+        scriptLineNumber++;
 
         // Remove trailing newline character
         if (read > 0 && input[read - 1] == '\n') {
@@ -76,13 +95,73 @@ char* getInput(int interactive)
     return input;
 }
 
+// Flags describing the commands of a script line, for the journal
+#define LINE_HAS_BUILTIN    1  ///< At least one command is a builtin
+#define LINE_HAS_BACKGROUND 2  ///< At least one command runs in the background
+
+/**
+ * @brief Finds out whether a tokenized line runs builtins or background commands.
+ *
+ * Walks the tokens the way parseTokens() does, without parsing them, since parsing opens the redirection files.
+ *
+ * @param tokens The tokens of the line.
+ * @return int A combination of the LINE_HAS_* flags.
+ */
+static int classifyLine(char** tokens)
+{
+    int flags = 0;
+    int expectCommand = 1;
+
+    for (int i = 0; tokens[i] != NULL; i++)
+    {
+        if (IGNORE(tokens[i]))
+            continue;
+
+        if (IS_BACKGROUND(tokens[i]))
+            flags |= LINE_HAS_BACKGROUND;
+
+        if (IS_CHAINING_OPERATOR(tokens[i]) || IS_PIPE(tokens[i]))
+        {
+            expectCommand = 1;
+        }
+        else if (IS_FILE_OUT_REDIR(tokens[i]) || IS_FILE_IN_REDIR(tokens[i]) || IS_STDERR_REDIR(tokens[i]))
+        {
+            // The file name isn't a command
+            while (tokens[i + 1] != NULL && IGNORE(tokens[i + 1]))
+                i++;
+            if (tokens[i + 1] != NULL)
+                i++;
+        }
+        else if (expectCommand)
+        {
+            expectCommand = 0;
+
+            // History expansion (!<number> or !<command>) runs the history builtin
+            if (tokens[i][0] == '!' && strlen(tokens[i]) > 1)
+            {
+                flags |= LINE_HAS_BUILTIN;
+                continue;
+            }
+
+            char* name = removeQuotes(strdup(tokens[i]));
+            if (getExecutionFunction(name) != executeProcess)
+                flags |= LINE_HAS_BUILTIN;
+            free(name);
+        }
+    }
+
+    return flags;
+}
+
 /**
  * @brief Handles SIGINT signal (Ctrl-C).
  * 
  * @param signo Signal number.
  */
 void sigint_handler(int signo) {
+    logSignalHandler(1);
     LOG_DEBUG("\nCTRL-C pressed. signo: %d\n", signo);  ///< Log SIGINT signal
+    logSignalHandler(0);
 }
 
 /**
@@ -91,7 +170,9 @@ void sigint_handler(int signo) {
  * @param signo Signal number.
  */
 void sigtstp_handler(int signo) {
+    logSignalHandler(1);
     LOG_DEBUG("\nCTRL-Z pressed. signo: %d\n", signo);  ///< Log SIGTSTP signal
+    logSignalHandler(0);
 }
 
 /**
@@ -100,7 +181,9 @@ void sigtstp_handler(int signo) {
  * @param signo Signal number.
  */
 void sigquit_handler(int signo) {
+    logSignalHandler(1);
     LOG_DEBUG("\nCTRL-\\ pressed. signo: %d\n", signo);  ///< Log SIGQUIT signal
+    logSignalHandler(0);
 }
 
 /**
@@ -111,6 +194,8 @@ void sigquit_handler(int signo) {
 void sigchld_handler(int signo) {
     (void) signo;  ///< Unused parameter
     int more = 1;  ///< Flag to check if more zombies need to be reaped
+    int reaped = 0;  ///< Number of zombies reaped in this invocation
+    int savedErrno = errno;  ///< errno of the interrupted code, restored on return
     pid_t pid;  ///< PID of the zombie process
     int status;  ///< Termination status of the zombie process
 
@@ -119,8 +204,14 @@ void sigchld_handler(int signo) {
         pid = waitpid(-1, &status, WNOHANG);  ///< Non-blocking wait for child processes
         if (pid <= 0) {
             more = 0;  ///< No more zombies or error
+        } else {
+            reaped++;
         }
     }
+
+    // Free the reaped children's slots in the spawn admission controller
+    spawnReaped(reaped);
+    errno = savedErrno;
 }
 
 /**
@@ -134,30 +225,97 @@ int main(int argc, char** argv)
 {
     // Default to interactive mode
     int interactive = 1;
+    int startupProfile = 0;  ///< Set by --startup-profile
+    int noRc = 0;  ///< Set by --norc
+    int lowMemory = 0;  ///< Set by --low-memory
+    int noEditing = 0;  ///< Set by --noediting
+    int resume = 0;  ///< Set by --resume
+    const char* journalPath = NULL;  ///< Set by --journal
+    const char* backendName = getenv(BACKEND_ENV);  ///< Set by --backend, defaults to the environment
+    const char* scriptPath = NULL;  ///< Script given on the command line, if any
     scriptFile = NULL;
 
-    // Check for correct number of arguments
-    if (argc > 2)
+    // Parse command line options
+    for (int i = 1; i < argc; i++)
     {
-        LOG_ERROR("Usage: %s [script]\n", argv[0]);
-        exit(1);  ///< Exit if arguments are incorrect
+        if (strcmp(argv[i], "--startup-profile") == 0) {
+            startupProfile = 1;
+        } else if (strcmp(argv[i], "--norc") == 0) {
+            noRc = 1;
+        } else if (strcmp(argv[i], "--low-memory") == 0) {
+            lowMemory = 1;
+        } else if (strcmp(argv[i], "--noediting") == 0) {
+            noEditing = 1;
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume = 1;
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journalPath = argv[++i];
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            backendName = argv[++i];
+        } else if (strncmp(argv[i], "--", 2) == 0 || scriptPath) {
+            LOG_ERROR("Usage: %s [--startup-profile] [--norc] [--low-memory] [--noediting] [--journal file] [--resume] [--backend linux|sim] [script]\n", argv[0]);
+            exit(1);  ///< Exit if arguments are incorrect
+        } else {
+            scriptPath = argv[i];
+        }
     }
 
     // If a script is provided, open it and set non-interactive mode
-    if (argc == 2)
+    if (scriptPath)
     {
         interactive = 0;
-        LOG_DEBUG("Running script %s\n", argv[1]);
-        scriptFile = fopen(argv[1], "r");
+        LOG_DEBUG("Running script %s\n", scriptPath);
+        scriptFile = fopen(scriptPath, "r");
         if (!scriptFile)
         {
-            LOG_ERROR("Error opening script %s: %s\n", argv[1], strerror(errno));
+            LOG_ERROR("Error opening script %s: %s\n", scriptPath, strerror(errno));
             exit(1);  ///< Exit if script file cannot be opened
         }
     }
 
+    // Journal mode records each completed top-level command of the script, --resume skips the ones that already succeeded
+    Journal journal = { .fd = -1 };
+    char defaultJournalPath[MAX_STRING_LENGTH];
+    if (journalPath || resume)
+    {
+        if (!scriptPath)
+        {
+            LOG_ERROR("--journal and --resume need a script\n");
+            exit(1);
+        }
+
+        if (!journalPath)
+        {
+            snprintf(defaultJournalPath, sizeof(defaultJournalPath), "%s%s", scriptPath, JOURNAL_SUFFIX);
+            journalPath = defaultJournalPath;
+        }
+
+        if (openJournal(&journal, journalPath, resume) != 0)
+            exit(1);  ///< Exit if the journal cannot be opened
+    }
+
+    // Start timing the startup phases
+    StartupProfile profile;
+    initStartupProfile(&profile, startupProfile);
+
+    // Pick up the log level and sink from the environment and start the log writer
+    initLogging();
+    endStartupPhase(&profile, STARTUP_PHASE_LOGGING);
+
     // Initialize global shell state
     globalShellState = init_shell_state();
+    initFootprint(lowMemory);
+    initLineEditor(interactive && !noEditing);
+    endStartupPhase(&profile, STARTUP_PHASE_STATE);
+
+    // Pick the execution backend, then initialize the spawn admission controller in front of it
+    if (backendName && selectBackend(backendName) != 0)
+    {
+        LOG_ERROR("Unknown backend '%s'\n", backendName);
+        exit(1);
+    }
+    initSpawnControl();
+    endStartupPhase(&profile, STARTUP_PHASE_SPAWN);
 
     LOG_DEBUG("Starting shell\n");
 
@@ -183,6 +341,16 @@ int main(int argc, char** argv)
         LOG_ERROR("Unable to register SIGCHLD handler");
         exit(EXIT_FAILURE);  ///< Exit if SIGCHLD handler cannot be set
     }
+    endStartupPhase(&profile, STARTUP_PHASE_SIGNALS);
+
+    // Interactive shells run ~/.modshellrc before the first prompt
+    if (interactive && !noRc)
+    {
+        runRcFile(&profile);
+        endStartupPhase(&profile, STARTUP_PHASE_RC);
+    }
+
+    reportStartupProfile(&profile);
 
     while (1)
     {
@@ -191,7 +359,9 @@ int main(int argc, char** argv)
         // Handle end-of-file (Ctrl-D) or errors
         if (input == NULL)
         {
-            if (feof(stdin)) {
+            if (!interactive && feof(scriptFile)) {
+                LOG_DEBUG("End of script\n");
+            } else if (interactive) {
                 printf("\nEOF detected. Exiting shell.\n");
             } else {
                 LOG_ERROR("Error reading input: %s\n", strerror(errno));
@@ -219,6 +389,17 @@ int main(int argc, char** argv)
         // Tokenize the input string
         char** tokens = tokenizeString(input, delimiter);
 
+        // On resume, skip lines of external commands that already succeeded. Lines with a builtin are replayed, since builtins are cheap and
+        // change the shell's state (cd, prompt).
+        int lineFlags = interactive ? 0 : classifyLine(tokens);
+        if (!interactive && !(lineFlags & LINE_HAS_BUILTIN) && journalShouldSkip(&journal, scriptLineNumber, input))
+        {
+            LOG_DEBUG("Skipping line %d, succeeded in a previous run\n", scriptLineNumber);
+            freeTokens(tokens);
+            free(input);
+            continue;
+        }
+
         // Log each token for debugging
         for (int i = 0; tokens[i] != NULL; i++) {
             LOG_DEBUG("Token %d: [%s]\n", i, tokens[i]);
@@ -233,6 +414,11 @@ int main(int argc, char** argv)
         // Execute the command chain and get the exit status
         int status = executeCommandChain(commandChain);
         LOG_DEBUG("Command executed with status %d\n", status);
+        lastExitStatus = status;
+
+        // Record the completed command in the journal. A background command has only been started, so its outcome is unknown.
+        if (!interactive && !(lineFlags & LINE_HAS_BACKGROUND))
+            journalRecord(&journal, scriptLineNumber, input, status);
 
         // Free memory allocated for tokens
         freeTokens(tokens);
@@ -242,10 +428,22 @@ int main(int argc, char** argv)
 
         // Free memory allocated for input buffer
         free(input);
+
+        // In low-memory mode, give memory freed by the command back to the system
+        trimAfterCommand();
     }
 
     // Clean up command history
     clean_history(&globalShellState->history);
 
+    // Clean up the job table
+    cleanUpJobs();
+
+    if (journal.fd != -1)
+    {
+        LOG_DEBUG("Journal: %lu commands skipped\n", journal.skipped);
+        closeJournal(&journal);
+    }
+
     return 0;  ///< Return success status
 }
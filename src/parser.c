@@ -1,5 +1,6 @@
 #include "parser.h"
 #include "shell_builtins.h"
+#include "backend.h"
 
 #include <fcntl.h>
 #include <glob.h>
@@ -89,7 +90,7 @@ CommandChain* parseTokens(char** tokens)
                 }
 
                 int pipeFD[2];
-                if (pipe(pipeFD) == -1)
+                if (execBackend->pipe(pipeFD) == -1)
                 {
                     LOG_DEBUG("Failed to create pipe\n");
                     cleanUpCommandChain(chain);
@@ -147,9 +148,9 @@ CommandChain* parseTokens(char** tokens)
                 } while (IGNORE(fileNameToken));
 
                 if (isAppend)
-                    fileFD = open(fileNameToken, O_WRONLY | O_CREAT | O_APPEND, 0644);
+                    fileFD = execBackend->open(fileNameToken, O_WRONLY | O_CREAT | O_APPEND, 0644);
                 else
-                    fileFD = open(fileNameToken, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                    fileFD = execBackend->open(fileNameToken, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
                 if (fileFD == -1)
                 {
@@ -179,7 +180,7 @@ CommandChain* parseTokens(char** tokens)
                     fileNameToken = tokens[++currentIndexInTokens];
                 } while (IGNORE(fileNameToken));
 
-                int fileFD = open(fileNameToken, O_RDONLY);
+                int fileFD = execBackend->open(fileNameToken, O_RDONLY, 0);
                 if (fileFD == -1)
                 {
                     LOG_DEBUG("Failed to open file for input redirection\n");
@@ -206,7 +207,7 @@ CommandChain* parseTokens(char** tokens)
                     fileNameToken = tokens[++currentIndexInTokens];
                 } while (IGNORE(fileNameToken));
 
-                int fileFD = open(fileNameToken, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                int fileFD = execBackend->open(fileNameToken, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
                 if (fileFD == -1)
                 {
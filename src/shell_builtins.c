@@ -8,8 +8,13 @@
 #include "shell_builtins.h"
 #include "parser.h"
 #include "command.h"
+#include "spawn.h"
+#include "footprint.h"
+#include "jobs.h"
+#include "backend.h"
 
 #include <errno.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <fcntl.h>
 
@@ -52,6 +57,7 @@ int add_to_history(HistoryList* list, char* command)
     }
 
     list->size++;
+    list->nodeCount++;
     return 0;
 }
 
@@ -66,9 +72,21 @@ int add_to_history(HistoryList* list, char* command)
  */
 char* get_command(HistoryList* list, unsigned int index)
 {
-    if (index > list->size || !list->head)
+    if (index == 0 || index > list->size)
         return NULL;
 
+    // Archived commands come first
+    if (index <= list->archiveCount)
+    {
+        char* entry = list->archive;
+        for (unsigned int ctr = 1; ctr != index; ctr++)
+            entry += strlen(entry) + 1;
+
+        return entry;
+    }
+
+    index -= list->archiveCount;
+
     HistoryNode* curr = list->head;
     unsigned int ctr = 1;
 
@@ -95,10 +113,75 @@ void clean_history(HistoryList* list) {
         current = next;
     }
 
+    if (list->archive)
+        munmap(list->archive, list->archiveMapped);
+
     // After cleaning up all nodes, reset the list
     list->head = NULL;
     list->tail = NULL;
     list->size = 0;
+    list->archive = NULL;
+    list->archiveLength = 0;
+    list->archiveMapped = 0;
+    list->archiveCount = 0;
+    list->nodeCount = 0;
+}
+
+/**
+ * @brief Moves the commands held in nodes into the read-only archive mapping.
+ * 
+ * Builds a new mapping holding the current archive followed by the nodes' commands, seals it read-only, then releases the nodes and the old mapping. Keeping the archive out of the malloc heap lets malloc_trim() give the freed node memory back to the system.
+ * 
+ * @param list The history list to compact.
+ * @return int Status code (0 on success, -1 on failure).
+ */
+int compact_history(HistoryList* list)
+{
+    if (!list->head)
+        return 0;
+
+    size_t needed = list->archiveLength;
+    for (HistoryNode* curr = list->head; curr; curr = curr->next)
+        needed += strlen(curr->command) + 1;
+
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapped = (needed + pageSize - 1) / pageSize * pageSize;
+
+    char* archive = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (archive == MAP_FAILED)
+    {
+        LOG_DEBUG("mmap: %s\n", strerror(errno));
+        return -1;
+    }
+
+    size_t length = list->archiveLength;
+    if (list->archive)
+        memcpy(archive, list->archive, length);
+
+    for (HistoryNode* curr = list->head; curr; curr = curr->next)
+    {
+        size_t commandLength = strlen(curr->command) + 1;
+        memcpy(archive + length, curr->command, commandLength);
+        length += commandLength;
+    }
+
+    mprotect(archive, mapped, PROT_READ);
+
+    if (list->archive)
+        munmap(list->archive, list->archiveMapped);
+
+    size_t archiveCount = list->size;
+    size_t size = list->size;
+    list->archive = NULL;
+    clean_history(list);
+
+    list->archive = archive;
+    list->archiveLength = length;
+    list->archiveMapped = mapped;
+    list->archiveCount = archiveCount;
+    list->size = size;
+
+    return 0;
 }
 
 /**
@@ -112,17 +195,28 @@ void clean_history(HistoryList* list) {
  */
 char* find_last_command_with_prefix(HistoryList* list, const char* prefix)
 {
-    if (list == NULL || list->head == NULL || prefix == NULL) {
+    if (list == NULL || list->size == 0 || prefix == NULL) {
         return NULL; // Invalid input
     }
 
     HistoryNode* current = list->head;
     char* lastCommand = NULL;
+    size_t prefixLength = strlen(prefix);
+
+    // Search the archive first, then the nodes, so the most recent match wins
+    char* entry = list->archive;
+    for (size_t i = 0; i < list->archiveCount; i++)
+    {
+        if (strncmp(entry, prefix, prefixLength) == 0)
+            lastCommand = entry;
+
+        entry += strlen(entry) + 1;
+    }
 
     while (current != NULL) 
     {
         // Check if the current command starts with the given prefix
-        if (strncmp(current->command, prefix, strlen(prefix)) == 0) {
+        if (strncmp(current->command, prefix, prefixLength) == 0) {
             // Update the lastCommand whenever a match is found
             lastCommand = current->command; // Duplicate the string
         }
@@ -161,6 +255,11 @@ ShellState* init_shell_state()
     stateObj->history.head = NULL;
     stateObj->history.tail = NULL;
     stateObj->history.size = 0;
+    stateObj->history.archive = NULL;
+    stateObj->history.archiveLength = 0;
+    stateObj->history.archiveMapped = 0;
+    stateObj->history.archiveCount = 0;
+    stateObj->history.nodeCount = 0;
 
     return stateObj;
 }
@@ -191,6 +290,8 @@ int clear_shell_state(ShellState* stateObj)
  * @brief Sets up file descriptors for input, output, and stderr.
  * 
  * Uses the `dup2` system call to duplicate file descriptors for input, output, and stderr if they differ from the default values.
+ * Descriptors of the simulated backend only exist in its tables and can't be moved onto the shell's own, so redirecting a builtin
+ * fails with an error under that backend.
  * 
  * @param inputFD The input file descriptor.
  * @param outputFD The output file descriptor.
@@ -199,13 +300,26 @@ int clear_shell_state(ShellState* stateObj)
  */
 static int setUpFD(int inputFD, int outputFD, int stderrFD)
 {
+    if (inputFD >= SIM_FD_BASE || outputFD >= SIM_FD_BASE || stderrFD >= SIM_FD_BASE)
+    {
+        LOG_ERROR("Builtins can't be redirected or piped with the %s backend\n", execBackend->name);
+
+        if (inputFD != STDIN_FD)
+            execBackend->close(inputFD);
+        if (outputFD != STDOUT_FD)
+            execBackend->close(outputFD);
+        if (stderrFD != STDERR_FD)
+            execBackend->close(stderrFD);
+        return -1;
+    }
+
     if (inputFD != STDIN_FD)
     {
         globalShellState->originalStdinFD = dup(STDIN_FD);
 
         if (dup2(inputFD, STDIN_FD) == -1)
         {
-            LOG_DEBUG("dup2: %s\n", strerror(errno));
+            LOG_ERROR("dup2: %s\n", strerror(errno));
             return -1;
         }
 
@@ -218,7 +332,7 @@ static int setUpFD(int inputFD, int outputFD, int stderrFD)
         
         if (dup2(outputFD, STDOUT_FD) == -1)
         {
-            LOG_DEBUG("dup2: %s\n", strerror(errno));
+            LOG_ERROR("dup2: %s\n", strerror(errno));
             return -1;
         }
 
@@ -231,7 +345,7 @@ static int setUpFD(int inputFD, int outputFD, int stderrFD)
         
         if (dup2(stderrFD, STDERR_FD) == -1)
         {
-            LOG_DEBUG("dup2: %s\n", strerror(errno));
+            LOG_ERROR("dup2: %s\n", strerror(errno));
             return -1;
         }
 
@@ -404,8 +518,19 @@ int history(SimpleCommand* simpleCommand)
 
     if (simpleCommand->argc == 1)
     {
-        HistoryNode* curr = globalShellState->history.head;
+        HistoryList* list = &globalShellState->history;
+        char* entry = list->archive;
         int i = 1;
+
+        // Archived commands first, then the ones still held in nodes
+        for (size_t j = 0; j < list->archiveCount; j++)
+        {
+            LOG_PRINT("%d %s\n", i, entry);
+            entry += strlen(entry) + 1;
+            i++;
+        }
+
+        HistoryNode* curr = list->head;
         while (curr)
         {
             LOG_PRINT("%d %s\n", i, curr->command);
@@ -467,50 +592,42 @@ int history(SimpleCommand* simpleCommand)
 /**
  * @brief Executes a simple command in a child process.
  * 
- * Forks a new process, sets up file descriptors, executes the command, and optionally waits for the child process to finish.
+ * Starts the command through the spawn admission controller and the active execution backend, which sets up the file descriptors and executes it, and optionally waits for the child process to finish.
  * 
  * @param simpleCommand The command to execute, including its arguments and file descriptors.
- * @return int Status code (0 on success, -1 on failure).
+ * @return int Status code (0 on success, SPAWN_FAILURE if the process could not be spawned, the exit status otherwise).
  */
 int executeProcess(SimpleCommand* simpleCommand)
 {
-    int pid = fork();
+    int pid = spawnProcess(simpleCommand);
 
     if (pid == -1)
     {
-        LOG_DEBUG("fork: %s\n", strerror(errno));
-        return -1;
-    }
-    else if (pid == 0)
-    {
-        // Child process
-        setUpFD(simpleCommand->inputFD, simpleCommand->outputFD, simpleCommand->stderrFD);
-
-        // Execute the command
-        if (execvp(simpleCommand->commandName, simpleCommand->args) == -1)
-        {
-            LOG_ERROR("%s: %s\n", simpleCommand->commandName, strerror(errno));
-            exit(1);
-        }
-
-        // This should never be reached
-        LOG_ERROR("This should never be reached\n");
-        exit(0);
+        LOG_ERROR("%s: fork: %s\n", simpleCommand->commandName, strerror(errno));
+        return SPAWN_FAILURE;
     }
     else
     {
-        // Parent process
+        // Parent process, the child was set up and executed by the backend
         simpleCommand->pid = pid;
 
         if (!simpleCommand->noWait) {
             // Wait for the child process to finish
             int status;
             LOG_DEBUG("Waiting for child process, with command name %s\n", simpleCommand->commandName);
-            if (waitpid(pid, &status, 0) == -1)
+            if (execBackend->wait(pid, &status, 0) == -1)
             {
                 LOG_ERROR("waitpid: %s\n", strerror(errno));
                 return -1;
             }
+            spawnReapedSafe(1);
+
+            // A child killed by a signal reports 128 + the signal number, like other shells
+            if (WIFSIGNALED(status))
+            {
+                LOG_DEBUG("Child killed by signal %d\n", WTERMSIG(status));
+                return 128 + WTERMSIG(status);
+            }
 
             // Print the exit status of the child process
             if (WEXITSTATUS(status) != 0)
@@ -552,6 +669,212 @@ int prompt(SimpleCommand* simpleCommand)
     return 0;
 }
 
+/**
+ * @brief Inspects and tunes the spawn admission controller.
+ * 
+ * Without arguments, prints the admission control settings and counters. With a setting name and a value, updates that setting.
+ * 
+ * @param simpleCommand The command to execute, optionally including a setting name and its new value.
+ * @return int Status code (0 on success, -1 on failure).
+ */
+int spawnctl(SimpleCommand* simpleCommand)
+{
+    if (simpleCommand->argc == 2 || simpleCommand->argc > 3)
+    {
+        LOG_ERROR("spawnctl: Usage: spawnctl [setting value]\n");
+        return -1;
+    }
+
+    if (simpleCommand->argc == 3)
+    {
+        return setSpawnOption(simpleCommand->args[1], simpleCommand->args[2]);
+    }
+
+    if (setUpFD(simpleCommand->inputFD, simpleCommand->outputFD, simpleCommand->stderrFD))
+    {
+        return -1;
+    }
+
+    printSpawnStats();
+
+    resetFD();
+    return 0;
+}
+
+/**
+ * @brief Inspects and changes the runtime logging configuration.
+ * 
+ * Without arguments, prints the log level, sink and writer counters. `log level <off|error|debug>` changes the level and `log sink <stderr|file:path|syslog[:socket]>` changes the sink.
+ * 
+ * @param simpleCommand The command to execute, optionally including a setting name and its new value.
+ * @return int Status code (0 on success, -1 on failure).
+ */
+int logCommand(SimpleCommand* simpleCommand)
+{
+    if (simpleCommand->argc == 2 || simpleCommand->argc > 3)
+    {
+        LOG_ERROR("log: Usage: log [level <off|error|debug> | sink <stderr|file:path|syslog[:socket]>]\n");
+        return -1;
+    }
+
+    if (simpleCommand->argc == 3)
+    {
+        if (strcmp(simpleCommand->args[1], "level") == 0)
+            return setLogLevel(simpleCommand->args[2]);
+
+        if (strcmp(simpleCommand->args[1], "sink") == 0)
+            return setLogSink(simpleCommand->args[2]);
+
+        LOG_ERROR("log: unknown setting '%s'\n", simpleCommand->args[1]);
+        return -1;
+    }
+
+    if (setUpFD(simpleCommand->inputFD, simpleCommand->outputFD, simpleCommand->stderrFD))
+    {
+        return -1;
+    }
+
+    printLogStatus();
+
+    resetFD();
+    return 0;
+}
+
+/**
+ * @brief Reports the shell's memory usage.
+ * 
+ * Prints the resident (RSS) and proportional (PSS) set sizes of the shell process and the history footprint.
+ * 
+ * @param simpleCommand The command to execute, expected to have no arguments.
+ * @return int Status code (0 on success, -1 on failure).
+ */
+int memstat(SimpleCommand* simpleCommand)
+{
+    if (simpleCommand->argc > 1)
+    {
+        LOG_ERROR("memstat: Too many arguments\n");
+        return -1;
+    }
+
+    if (setUpFD(simpleCommand->inputFD, simpleCommand->outputFD, simpleCommand->stderrFD))
+    {
+        return -1;
+    }
+
+    int status = printMemoryUsage();
+
+    resetFD();
+    return status;
+}
+
+/**
+ * @brief Lists the background jobs.
+ * 
+ * Prints each job's number, process group, state and command line. With `-v`, also samples and prints the CPU usage, RSS and I/O of every process in each job's process group. Finished jobs are forgotten once listed.
+ * 
+ * @param simpleCommand The command to execute, optionally including `-v`.
+ * @return int Status code (0 on success, -1 on failure).
+ */
+int jobsCommand(SimpleCommand* simpleCommand)
+{
+    int verbose = simpleCommand->argc == 2 && strcmp(simpleCommand->args[1], "-v") == 0;
+
+    if (simpleCommand->argc > 2 || (simpleCommand->argc == 2 && !verbose))
+    {
+        LOG_ERROR("jobs: Usage: jobs [-v]\n");
+        return -1;
+    }
+
+    if (setUpFD(simpleCommand->inputFD, simpleCommand->outputFD, simpleCommand->stderrFD))
+    {
+        return -1;
+    }
+
+    int status = printJobs(verbose);
+
+    resetFD();
+    return status;
+}
+
+/**
+ * @brief Shows the live resource usage of the background jobs.
+ * 
+ * Redraws the CPU usage, RSS and I/O of every process in each job's process group on every sampling interval, until Enter is pressed or the jobs finish.
+ * 
+ * @param simpleCommand The command to execute, optionally including the interval in milliseconds and the number of samples.
+ * @return int Status code (0 on success, -1 on failure).
+ */
+int jobtop(SimpleCommand* simpleCommand)
+{
+    int intervalMs = JOBTOP_DEFAULT_INTERVAL_MS;
+    int count = 0;
+
+    if (simpleCommand->argc > 3)
+    {
+        LOG_ERROR("jobtop: Usage: jobtop [interval_ms [count]]\n");
+        return -1;
+    }
+
+    for (int i = 1; i < simpleCommand->argc; i++)
+    {
+        if (strspn(simpleCommand->args[i], "0123456789") != strlen(simpleCommand->args[i]))
+        {
+            LOG_ERROR("jobtop: Expects numerical arguments\n");
+            return -1;
+        }
+    }
+
+    if (simpleCommand->argc > 1)
+        intervalMs = atoi(simpleCommand->args[1]);
+    if (simpleCommand->argc > 2)
+        count = atoi(simpleCommand->args[2]);
+
+    if (intervalMs <= 0)
+    {
+        LOG_ERROR("jobtop: The interval must be positive\n");
+        return -1;
+    }
+
+    if (setUpFD(simpleCommand->inputFD, simpleCommand->outputFD, simpleCommand->stderrFD))
+    {
+        return -1;
+    }
+
+    int status = runJobTop(intervalMs, count);
+
+    resetFD();
+    return status;
+}
+
+/**
+ * @brief Reports the active execution backend.
+ * 
+ * Prints the name of the backend, followed by its counters when it has any.
+ * 
+ * @param simpleCommand The command to execute.
+ * @return int Status code (0 on success, -1 on failure).
+ */
+int backendCommand(SimpleCommand* simpleCommand)
+{
+    if (simpleCommand->argc > 1)
+    {
+        LOG_ERROR("backend: Too many arguments\n");
+        return -1;
+    }
+
+    if (setUpFD(simpleCommand->inputFD, simpleCommand->outputFD, simpleCommand->stderrFD))
+    {
+        return -1;
+    }
+
+    LOG_PRINT("backend        %s\n", execBackend->name);
+    if (execBackend->printStats)
+        execBackend->printStats();
+
+    resetFD();
+    return 0;
+}
+
 /*-------------------------------Command Registry----------------------------------*/
 
 /**
@@ -578,6 +901,12 @@ static const CommandRegistry commandRegistry[] = {
     {"exit", exitShell},
     {"history", history},
     {"prompt", prompt},
+    {"spawnctl", spawnctl},
+    {"log", logCommand},
+    {"memstat", memstat},
+    {"jobs", jobsCommand},
+    {"jobtop", jobtop},
+    {"backend", backendCommand},
     {NULL, NULL}
 };
 
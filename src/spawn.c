@@ -0,0 +1,430 @@
+/**
+ * @file spawn.c
+ * @brief Function definitions for the spawn admission controller.
+ * @version 0.1
+ *
+ */
+
+#include "spawn.h"
+#include "backend.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+SpawnConfig spawnConfig;                ///< Active admission control settings
+SpawnStats spawnStats;                  ///< Admission control counters
+volatile sig_atomic_t activeChildren;   ///< Number of children forked and not yet reaped
+
+// Reasons for holding back a spawn
+#define ADMIT_OK        0   /**< The spawn may proceed */
+#define ADMIT_CAP       1   /**< The concurrent children cap is reached */
+#define ADMIT_PRESSURE  2   /**< Load average or memory pressure is above its threshold */
+
+// Cached result of the last pressure sample, so that large fan-outs don't read /proc on every fork
+static long lastSampleMs = -1;
+static int lastPressureHigh = 0;
+
+/*-------------------------------Helpers----------------------------------*/
+
+/**
+ * @brief Returns the monotonic clock in milliseconds.
+ *
+ * @return long Milliseconds since an arbitrary point in the past.
+ */
+static long monotonicMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/**
+ * @brief Reads the 1-minute load average.
+ *
+ * @return double The load average, or -1 if it can't be read.
+ */
+static double readLoadavg()
+{
+    FILE* file = fopen(SPAWN_LOADAVG_FILE, "r");
+    if (!file)
+        return -1;
+
+    double load = -1;
+    if (fscanf(file, "%lf", &load) != 1)
+        load = -1;
+
+    fclose(file);
+    return load;
+}
+
+/**
+ * @brief Reads the "some avg10" memory pressure percentage from PSI.
+ *
+ * @return double The percentage of time some task stalled on memory over the last 10 seconds, or -1 if PSI is unavailable.
+ */
+static double readMemPressure()
+{
+    FILE* file = fopen(SPAWN_MEM_PRESSURE_FILE, "r");
+    if (!file)
+        return -1;
+
+    double avg10 = -1;
+    if (fscanf(file, "some avg10=%lf", &avg10) != 1)
+        avg10 = -1;
+
+    fclose(file);
+    return avg10;
+}
+
+/**
+ * @brief Checks whether the system is under enough pressure to shed load.
+ *
+ * The files are sampled at most once per sample interval, the cached verdict is returned in between.
+ *
+ * @return int 1 if a threshold is exceeded, 0 otherwise.
+ */
+static int pressureHigh()
+{
+    if (spawnConfig.loadavgThreshold <= 0 && spawnConfig.memPressureThreshold <= 0)
+        return 0;
+
+    long now = monotonicMs();
+    if (lastSampleMs >= 0 && now - lastSampleMs < spawnConfig.sampleIntervalMs)
+        return lastPressureHigh;
+
+    lastSampleMs = now;
+    lastPressureHigh = 0;
+
+    if (spawnConfig.loadavgThreshold > 0)
+    {
+        double load = readLoadavg();
+        if (load >= spawnConfig.loadavgThreshold)
+        {
+            LOG_DEBUG("Load average %.2f above threshold %.2f\n", load, spawnConfig.loadavgThreshold);
+            lastPressureHigh = 1;
+        }
+    }
+
+    if (!lastPressureHigh && spawnConfig.memPressureThreshold > 0)
+    {
+        double pressure = readMemPressure();
+        if (pressure >= spawnConfig.memPressureThreshold)
+        {
+            LOG_DEBUG("Memory pressure %.2f above threshold %.2f\n", pressure, spawnConfig.memPressureThreshold);
+            lastPressureHigh = 1;
+        }
+    }
+
+    return lastPressureHigh;
+}
+
+/**
+ * @brief Reaps finished children without blocking.
+ *
+ * Background children are normally reaped by the SIGCHLD handler, this only catches up when the cap is reached before the handler ran.
+ *
+ * @return int 1 if children are still running, 0 if none is left.
+ */
+static int reapFinished()
+{
+    int reaped = 0;
+    pid_t pid;
+    while ((pid = execBackend->wait(-1, NULL, WNOHANG)) > 0)
+        reaped++;
+
+    if (reaped)
+        spawnReapedSafe(reaped);
+
+    return !(pid == -1 && errno == ECHILD);
+}
+
+/**
+ * @brief Decides whether a spawn may proceed right now.
+ *
+ * @return int ADMIT_OK, ADMIT_CAP or ADMIT_PRESSURE.
+ */
+static int admit()
+{
+    if (spawnConfig.maxChildren > 0 && activeChildren >= spawnConfig.maxChildren)
+    {
+        reapFinished();
+        if (activeChildren >= spawnConfig.maxChildren)
+            return ADMIT_CAP;
+    }
+
+    if (pressureHigh())
+        return ADMIT_PRESSURE;
+
+    return ADMIT_OK;
+}
+
+/**
+ * @brief Waits for a child to exit while the cap is reached.
+ *
+ * Called with SIGCHLD blocked. Waiting for a slot isn't a failure, so it doesn't use up a backoff round.
+ *
+ * @param mask The signal mask to wait with, the one from before SIGCHLD was blocked.
+ */
+static void waitForSlot(const sigset_t* mask)
+{
+    if (!reapFinished())
+    {
+        // Only a bug in the bookkeeping can get here, waiting would never end
+        LOG_ERROR("spawn: %d children counted but none is running, resetting the count\n", (int)activeChildren);
+        activeChildren = 0;
+        return;
+    }
+
+    execBackend->waitChild(mask);
+}
+
+/**
+ * @brief Sleeps for the backoff delay of the given round.
+ *
+ * The delay doubles every round up to the configured maximum. Half of it is randomized ("equal jitter") so that shells hitting the same
+ * limit at the same time don't retry in lockstep. A SIGCHLD cuts the sleep short, which is fine since it may have freed a slot.
+ *
+ * @param round The zero based backoff round.
+ */
+static void backoff(int round)
+{
+    long delay = spawnConfig.baseDelayUs;
+    for (int i = 0; i < round && delay < spawnConfig.maxDelayUs; i++)
+        delay *= 2;
+
+    if (delay > spawnConfig.maxDelayUs)
+        delay = spawnConfig.maxDelayUs;
+
+    long half = delay / 2;
+    delay = half + (half > 0 ? random() % (half + 1) : 0);
+
+    execBackend->sleep(delay);
+}
+
+/*-------------------------------Admission Control----------------------------------*/
+
+// Initializes the admission controller with its default settings
+void initSpawnControl()
+{
+    spawnConfig.maxChildren          = SPAWN_DEFAULT_MAX_CHILDREN;
+    spawnConfig.maxRetries           = SPAWN_DEFAULT_MAX_RETRIES;
+    spawnConfig.baseDelayUs          = SPAWN_DEFAULT_BASE_DELAY_US;
+    spawnConfig.maxDelayUs           = SPAWN_DEFAULT_MAX_DELAY_US;
+    spawnConfig.loadavgThreshold     = 0;
+    spawnConfig.memPressureThreshold = 0;
+    spawnConfig.sampleIntervalMs     = SPAWN_DEFAULT_SAMPLE_MS;
+
+    memset(&spawnStats, 0, sizeof(spawnStats));
+    activeChildren = 0;
+    lastSampleMs = -1;
+
+    srandom((unsigned int)(getpid() ^ monotonicMs()));
+}
+
+// Starts a command through the admission controller
+pid_t spawnProcess(SimpleCommand* simpleCommand)
+{
+    sigset_t mask, oldMask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+
+    int round = 0;
+    while (1)
+    {
+        // SIGCHLD stays blocked until the new child is counted, otherwise the handler could reap it before it is
+        sigprocmask(SIG_BLOCK, &mask, &oldMask);
+        int verdict = admit();
+
+        if (verdict == ADMIT_CAP)
+        {
+            // Queue until a child exits
+            spawnStats.capWaits++;
+            waitForSlot(&oldMask);
+            sigprocmask(SIG_SETMASK, &oldMask, NULL);
+            continue;
+        }
+
+        if (verdict == ADMIT_OK)
+        {
+            pid_t pid = execBackend->spawn(simpleCommand);
+
+            if (pid > 0)
+            {
+                activeChildren++;
+                if (activeChildren > spawnStats.peakChildren)
+                    spawnStats.peakChildren = activeChildren;
+
+                sigprocmask(SIG_SETMASK, &oldMask, NULL);
+
+                spawnStats.spawned++;
+                return pid;
+            }
+
+            int spawnErrno = errno;
+            sigprocmask(SIG_SETMASK, &oldMask, NULL);
+            errno = spawnErrno;
+
+            // Only process table or memory exhaustion is worth retrying
+            if (errno != EAGAIN && errno != ENOMEM)
+            {
+                spawnStats.forkFailures++;
+                return -1;
+            }
+
+            LOG_DEBUG("spawn: %s, retrying (round %d)\n", strerror(errno), round);
+            spawnStats.forkRetries++;
+        }
+        else
+        {
+            sigprocmask(SIG_SETMASK, &oldMask, NULL);
+            spawnStats.pressureWaits++;
+        }
+
+        if (round >= spawnConfig.maxRetries)
+        {
+            if (verdict == ADMIT_OK)
+                spawnStats.forkFailures++;
+            else
+                spawnStats.shed++;
+
+            errno = EAGAIN;
+            return -1;
+        }
+
+        backoff(round);
+        round++;
+    }
+}
+
+// Records that children have been reaped, called from the SIGCHLD handler
+void spawnReaped(int count)
+{
+    activeChildren -= count;
+}
+
+// Records that children have been reaped, from outside the SIGCHLD handler
+void spawnReapedSafe(int count)
+{
+    sigset_t mask, oldMask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &oldMask);
+
+    spawnReaped(count);
+
+    sigprocmask(SIG_SETMASK, &oldMask, NULL);
+}
+
+/*-------------------------------Reporting and Tuning----------------------------------*/
+
+// Prints the admission control settings and counters
+void printSpawnStats()
+{
+    LOG_PRINT("max-children   %d\n", spawnConfig.maxChildren);
+    LOG_PRINT("retries        %d\n", spawnConfig.maxRetries);
+    LOG_PRINT("base-delay-us  %ld\n", spawnConfig.baseDelayUs);
+    LOG_PRINT("max-delay-us   %ld\n", spawnConfig.maxDelayUs);
+    LOG_PRINT("loadavg        %.2f\n", spawnConfig.loadavgThreshold);
+    LOG_PRINT("mem-pressure   %.2f\n", spawnConfig.memPressureThreshold);
+    LOG_PRINT("sample-ms      %ld\n", spawnConfig.sampleIntervalMs);
+    LOG_PRINT("active         %d\n", (int)activeChildren);
+    LOG_PRINT("peak           %d\n", spawnStats.peakChildren);
+    LOG_PRINT("spawned        %lu\n", spawnStats.spawned);
+    LOG_PRINT("fork-retries   %lu\n", spawnStats.forkRetries);
+    LOG_PRINT("fork-failures  %lu\n", spawnStats.forkFailures);
+    LOG_PRINT("cap-waits      %lu\n", spawnStats.capWaits);
+    LOG_PRINT("pressure-waits %lu\n", spawnStats.pressureWaits);
+    LOG_PRINT("shed           %lu\n", spawnStats.shed);
+}
+
+/**
+ * @brief Parses a non-negative integer setting.
+ *
+ * @param value The value, as a string.
+ * @param max The largest accepted value.
+ * @param result Where to store the parsed value.
+ * @return int 0 on success, -1 if the value is not an integer in [0, max].
+ */
+static int parseInteger(const char* value, long max, long* result)
+{
+    char* end = NULL;
+    errno = 0;
+    long number = strtol(value, &end, 10);
+
+    if (end == value || *end != '\0' || errno == ERANGE || number < 0 || number > max)
+        return -1;
+
+    *result = number;
+    return 0;
+}
+
+/**
+ * @brief Parses a non-negative threshold setting.
+ *
+ * @param value The value, as a string.
+ * @param result Where to store the parsed value.
+ * @return int 0 on success, -1 if the value is not a finite non-negative number.
+ */
+static int parseThreshold(const char* value, double* result)
+{
+    char* end = NULL;
+    errno = 0;
+    double number = strtod(value, &end);
+
+    if (end == value || *end != '\0' || errno == ERANGE || !isfinite(number) || number < 0)
+        return -1;
+
+    *result = number;
+    return 0;
+}
+
+// Updates one admission control setting
+int setSpawnOption(const char* key, const char* value)
+{
+    int isThreshold = strcmp(key, "loadavg") == 0 || strcmp(key, "mem-pressure") == 0;
+    long max = 0;
+
+    if (strcmp(key, "max-children") == 0 || strcmp(key, "retries") == 0)
+        max = INT_MAX;
+    else if (strcmp(key, "base-delay-us") == 0 || strcmp(key, "max-delay-us") == 0)
+        max = SPAWN_MAX_DELAY_LIMIT_US;
+    else if (strcmp(key, "sample-ms") == 0)
+        max = LONG_MAX;
+    else if (!isThreshold)
+    {
+        LOG_ERROR("spawnctl: unknown setting '%s'\n", key);
+        return -1;
+    }
+
+    long number = 0;
+    double threshold = 0;
+    if (isThreshold ? parseThreshold(value, &threshold) != 0 : parseInteger(value, max, &number) != 0)
+    {
+        LOG_ERROR("spawnctl: invalid value '%s' for %s\n", value, key);
+        return -1;
+    }
+
+    if (strcmp(key, "max-children") == 0)
+        spawnConfig.maxChildren = (int)number;
+    else if (strcmp(key, "retries") == 0)
+        spawnConfig.maxRetries = (int)number;
+    else if (strcmp(key, "base-delay-us") == 0)
+        spawnConfig.baseDelayUs = number;
+    else if (strcmp(key, "max-delay-us") == 0)
+        spawnConfig.maxDelayUs = number;
+    else if (strcmp(key, "sample-ms") == 0)
+        spawnConfig.sampleIntervalMs = number;
+    else if (strcmp(key, "loadavg") == 0)
+        spawnConfig.loadavgThreshold = threshold;
+    else
+        spawnConfig.memPressureThreshold = threshold;
+
+    // Force a fresh sample with the new thresholds
+    lastSampleMs = -1;
+    return 0;
+}
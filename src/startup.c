@@ -0,0 +1,269 @@
+/**
+ * @file startup.c
+ * @brief Function definitions for the rc-file loader and the startup-time profiler.
+ * @version 0.1
+ *
+ */
+
+#include "startup.h"
+#include "parser.h"
+#include "shell_builtins.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+// Names of the startup phases, as printed in the report
+static const char* phaseNames[STARTUP_PHASES] = {
+    "logging",
+    "init_shell_state",
+    "spawn control",
+    "signal setup",
+    "history load",
+    "rc execution",
+};
+
+/*-------------------------------Startup Profile----------------------------------*/
+
+/**
+ * @brief Returns the time elapsed between two timestamps in milliseconds.
+ *
+ * @param from The earlier timestamp.
+ * @param to The later timestamp.
+ * @return double Elapsed milliseconds.
+ */
+static double elapsedMs(const struct timespec* from, const struct timespec* to)
+{
+    return (to->tv_sec - from->tv_sec) * 1e3 + (to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+// Starts the startup profile clock
+void initStartupProfile(StartupProfile* profile, int enabled)
+{
+    profile->enabled = enabled;
+    profile->rcLines = NULL;
+    profile->nRcLines = 0;
+
+    for (int i = 0; i < STARTUP_PHASES; i++)
+        profile->phaseMs[i] = -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &profile->start);
+    profile->phaseStart = profile->start;
+}
+
+// Ends the current phase and starts the next one
+void endStartupPhase(StartupProfile* profile, int phase)
+{
+    if (!profile->enabled)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    profile->phaseMs[phase] = elapsedMs(&profile->phaseStart, &now);
+    profile->phaseStart = now;
+}
+
+// Prints the startup profile to stderr and frees its per-line timings
+void reportStartupProfile(StartupProfile* profile)
+{
+    if (!profile->enabled)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    fprintf(stderr, "startup profile:\n");
+    for (int i = 0; i < STARTUP_PHASES; i++)
+    {
+        if (i == STARTUP_PHASE_HISTORY && profile->phaseMs[i] < 0)
+            fprintf(stderr, "  %-18s       n/a (history is not persisted)\n", phaseNames[i]);
+        else if (profile->phaseMs[i] < 0)
+            fprintf(stderr, "  %-18s       skipped\n", phaseNames[i]);
+        else
+            fprintf(stderr, "  %-18s %8.3f ms\n", phaseNames[i], profile->phaseMs[i]);
+    }
+
+    for (int i = 0; i < profile->nRcLines; i++)
+    {
+        fprintf(stderr, "    rc:%-4d %8.3f ms  %s\n", profile->rcLines[i].lineNumber, profile->rcLines[i].ms, profile->rcLines[i].text);
+        free(profile->rcLines[i].text);
+    }
+
+    fprintf(stderr, "  %-18s %8.3f ms\n", "first prompt", elapsedMs(&profile->start, &now));
+
+    free(profile->rcLines);
+    profile->rcLines = NULL;
+    profile->nRcLines = 0;
+}
+
+/*-------------------------------Script Plans----------------------------------*/
+
+// Reads a script and tokenizes each of its command lines
+ScriptPlan* loadScriptPlan(const char* path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    ScriptPlan* plan = malloc(sizeof(ScriptPlan));
+    if (!plan)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    plan->buffer = malloc(st.st_size + 1);
+    plan->lines = NULL;
+    plan->nLines = 0;
+    if (!plan->buffer)
+    {
+        close(fd);
+        free(plan);
+        return NULL;
+    }
+
+    // Read the whole file in one go, the size is only a hint in case the file changes under us
+    size_t length = 0;
+    ssize_t got;
+    while (length < (size_t)st.st_size && (got = read(fd, plan->buffer + length, st.st_size - length)) != 0)
+    {
+        if (got == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            close(fd);
+            cleanUpScriptPlan(plan);
+            return NULL;
+        }
+        length += got;
+    }
+    plan->buffer[length] = '\0';
+    close(fd);
+
+    // Count the lines to size the plan with a single allocation
+    int maxLines = 1;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (plan->buffer[i] == '\n')
+            maxLines++;
+    }
+
+    plan->lines = malloc(sizeof(ScriptLine) * maxLines);
+    if (!plan->lines)
+    {
+        cleanUpScriptPlan(plan);
+        return NULL;
+    }
+
+    char* line = plan->buffer;
+    for (int lineNumber = 1; line; lineNumber++)
+    {
+        char* newline = strchr(line, '\n');
+        if (newline)
+            *newline = '\0';
+
+        // Skip leading whitespace, blank lines and comments
+        char* text = line + strspn(line, " \t");
+        if (*text != '\0' && *text != '#')
+        {
+            ScriptLine* entry = &plan->lines[plan->nLines];
+            entry->lineNumber = lineNumber;
+            entry->text = text;
+            entry->tokens = tokenizeString(text, ' ');
+            if (!entry->tokens)
+            {
+                cleanUpScriptPlan(plan);
+                return NULL;
+            }
+            plan->nLines++;
+        }
+
+        line = newline ? newline + 1 : NULL;
+    }
+
+    return plan;
+}
+
+// Frees a script plan
+void cleanUpScriptPlan(ScriptPlan* plan)
+{
+    if (!plan)
+        return;
+
+    for (int i = 0; i < plan->nLines; i++)
+    {
+        if (plan->lines[i].tokens)
+            freeTokens(plan->lines[i].tokens);
+    }
+
+    free(plan->lines);
+    free(plan->buffer);
+    free(plan);
+}
+
+/*-------------------------------rc File----------------------------------*/
+
+// Runs the rc file from the home directory, if there is one
+int runRcFile(StartupProfile* profile)
+{
+    const char* home = HOME_DIR;
+    if (!home)
+        return 0;
+
+    char path[MAX_PATH_LENGTH];
+    if (snprintf(path, sizeof(path), "%s/%s", home, RC_FILE_NAME) >= (int)sizeof(path))
+        return 0;
+
+    ScriptPlan* plan = loadScriptPlan(path);
+    if (!plan)
+    {
+        if (errno == ENOENT)
+            return 0;
+
+        LOG_ERROR("%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    if (profile->enabled)
+    {
+        profile->rcLines = malloc(sizeof(RcLineTiming) * (plan->nLines ? plan->nLines : 1));
+        profile->nRcLines = 0;
+    }
+
+    for (int i = 0; i < plan->nLines; i++)
+    {
+        struct timespec lineStart, lineEnd;
+        if (profile->rcLines)
+            clock_gettime(CLOCK_MONOTONIC, &lineStart);
+
+        LOG_DEBUG("rc:%d: %s\n", plan->lines[i].lineNumber, plan->lines[i].text);
+
+        // The tokens were prepared when the plan was loaded, parsing opens redirections and pipes so it has to happen now
+        CommandChain* commandChain = parseTokens(plan->lines[i].tokens);
+        int status = executeCommandChain(commandChain);
+        cleanUpCommandChain(commandChain);
+
+        if (status != 0)
+            LOG_DEBUG("rc:%d: exited with status %d\n", plan->lines[i].lineNumber, status);
+
+        if (profile->rcLines)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &lineEnd);
+            RcLineTiming* timing = &profile->rcLines[profile->nRcLines++];
+            timing->lineNumber = plan->lines[i].lineNumber;
+            timing->ms = elapsedMs(&lineStart, &lineEnd);
+            timing->text = COPY(plan->lines[i].text);
+        }
+    }
+
+    cleanUpScriptPlan(plan);
+    return 0;
+}
@@ -0,0 +1,533 @@
+/**
+ * @file syntax.c
+ * @brief Function definitions for the incremental syntax checker and the PATH cache.
+ * @version 0.1
+ *
+ */
+
+#include "syntax.h"
+#include "shell_builtins.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Structure holding the set of executable names found in PATH
+typedef struct PathCache {
+    int built;                 /**< Whether the cache has been built since it was last freed */
+    char* path;                /**< PATH value the cache was built for */
+    struct timespec* mtimes;   /**< Modification time of each PATH directory when the cache was built */
+    int nDirs;                 /**< Number of PATH directories */
+    char* names;               /**< Executable names, NUL-terminated, one after the other */
+    size_t namesLength;        /**< Bytes used in names */
+    size_t namesCapacity;      /**< Bytes allocated for names */
+    size_t* slots;             /**< Open addressing hash table of offsets into names, plus one, 0 for an empty slot */
+    size_t nSlots;             /**< Number of slots, a power of two */
+    size_t nEntries;           /**< Number of names in the table */
+} PathCache;
+
+static PathCache pathCache;
+
+/*-------------------------------Lexer----------------------------------*/
+
+/**
+ * @brief Classifies a token.
+ *
+ * @param text The token's first character.
+ * @param length Length of the token.
+ * @return int TOKEN_WORD, TOKEN_SEPARATOR or TOKEN_REDIRECTION.
+ */
+static int classifyToken(const char* text, int length)
+{
+    if (length == 1 && (text[0] == '|' || text[0] == ';' || text[0] == '&'))
+        return TOKEN_SEPARATOR;
+
+    if ((length == 1 && (text[0] == '<' || text[0] == '>')) || (length == 2 && (strncmp(text, ">>", 2) == 0 || strncmp(text, "2>", 2) == 0)))
+        return TOKEN_REDIRECTION;
+
+    return TOKEN_WORD;
+}
+
+/**
+ * @brief Lexes the next token of a line.
+ *
+ * Lexing always starts outside quotes: tokens only end on a space outside quotes, or at the end of the line.
+ *
+ * @param line The line.
+ * @param length Length of the line.
+ * @param from Offset to start at.
+ * @param token Where to store the token.
+ * @return int 1 if a token was found, 0 at the end of the line.
+ */
+static int lexToken(const char* line, int length, int from, SyntaxToken* token)
+{
+    int i = from;
+    while (i < length && line[i] == ' ')
+        i++;
+
+    if (i == length)
+        return 0;
+
+    // Like tokenizeString(), either quote character opens and closes a quoted section
+    int insideQuotes = 0;
+    token->start = i;
+    while (i < length && (line[i] != ' ' || insideQuotes))
+    {
+        if (line[i] == '"' || line[i] == '\'')
+            insideQuotes = !insideQuotes;
+        i++;
+    }
+
+    token->end = i;
+    token->kind = classifyToken(line + token->start, token->end - token->start);
+    token->unterminated = insideQuotes;
+    token->error = SYNTAX_OK;
+    return 1;
+}
+
+/*-------------------------------Parser----------------------------------*/
+
+/**
+ * @brief Checks whether a command name can be looked up at all.
+ *
+ * Quoted names, glob patterns and history expansions are only known once expanded, they are never reported.
+ *
+ * @param text The name.
+ * @param length Length of the name.
+ * @return int 1 if the name should be looked up, 0 otherwise.
+ */
+static int checkableName(const char* text, int length)
+{
+    if (text[0] == '!')
+        return 0;
+
+    for (int i = 0; i < length; i++)
+    {
+        if (strchr("\"'*?[", text[i]))
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Computes the diagnostic of a token and the parser state after it.
+ *
+ * @param token The token, with its state before it set.
+ * @param line The line.
+ */
+static void parseToken(SyntaxToken* token, const char* line)
+{
+    const char* text = line + token->start;
+    int length = token->end - token->start;
+
+    token->error = SYNTAX_OK;
+
+    if (token->kind == TOKEN_WORD)
+    {
+        if (token->expectBefore == EXPECT_COMMAND && !token->unterminated && checkableName(text, length) && !commandExists(text, length))
+            token->error = SYNTAX_UNKNOWN_COMMAND;
+
+        token->expectAfter = EXPECT_ARG;
+        return;
+    }
+
+    // Operators must follow a command or one of its arguments
+    if (token->expectBefore != EXPECT_ARG)
+        token->error = SYNTAX_MISPLACED_OPERATOR;
+
+    token->expectAfter = token->kind == TOKEN_SEPARATOR ? EXPECT_COMMAND : EXPECT_TARGET;
+}
+
+// Resets the state for an empty line
+void initSyntaxState(SyntaxState* state)
+{
+    state->nTokens = 0;
+    state->nErrors = 0;
+    state->changedFrom = 0;
+}
+
+// Finds the token at an offset
+int syntaxTokenAt(SyntaxState* state, int position)
+{
+    int low = 0, high = state->nTokens - 1, found = -1;
+
+    while (low <= high)
+    {
+        int middle = (low + high) / 2;
+        if (state->tokens[middle].start <= position)
+        {
+            found = middle;
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    return found;
+}
+
+// Updates the state after an edit of the line
+void syntaxEdit(SyntaxState* state, const char* line, int length, int position, int removed, int inserted)
+{
+    SyntaxToken fresh[MAX_STRING_LENGTH / 2 + 1];
+    int nFresh = 0;
+    int delta = inserted - removed;
+
+    // The token the edit starts in may merge with or split into its neighbours, lexing restarts from its start
+    int first = syntaxTokenAt(state, position);
+    if (first == -1)
+        first = 0;
+
+    int from = position;
+    if (first < state->nTokens && state->tokens[first].start < from)
+        from = state->tokens[first].start;
+
+    // Lex until a new token starts where an old token past the edit started, everything from there on is unchanged
+    int resync = first;
+    int resynced = 0;
+    SyntaxToken token;
+    while (lexToken(line, length, from, &token))
+    {
+        if (token.start >= position + inserted)
+        {
+            while (resync < state->nTokens && state->tokens[resync].start + delta < token.start)
+                resync++;
+
+            if (resync < state->nTokens && state->tokens[resync].start >= position + removed && state->tokens[resync].start + delta == token.start)
+            {
+                resynced = 1;
+                break;
+            }
+        }
+
+        fresh[nFresh++] = token;
+        from = token.end;
+    }
+
+    if (!resynced)
+        resync = state->nTokens;
+
+    // Replace the old tokens [first, resync) with the fresh ones and shift the unchanged ones, the only part of an edit that grows with
+    // the number of tokens after it
+    for (int i = first; i < resync; i++)
+    {
+        if (state->tokens[i].error != SYNTAX_OK)
+            state->nErrors--;
+    }
+
+    int tail = state->nTokens - resync;
+    memmove(&state->tokens[first + nFresh], &state->tokens[resync], tail * sizeof(SyntaxToken));
+    for (int i = first + nFresh; i < first + nFresh + tail; i++)
+    {
+        state->tokens[i].start += delta;
+        state->tokens[i].end += delta;
+    }
+
+    memcpy(&state->tokens[first], fresh, nFresh * sizeof(SyntaxToken));
+    state->nTokens = first + nFresh + tail;
+
+    // Parse again until the parser state before an unchanged token is what it was
+    int expect = first > 0 ? state->tokens[first - 1].expectAfter : EXPECT_COMMAND;
+    for (int i = first; i < state->nTokens; i++)
+    {
+        SyntaxToken* current = &state->tokens[i];
+        int unchanged = i >= first + nFresh;
+
+        if (unchanged && current->expectBefore == expect)
+            break;
+
+        int oldError = unchanged ? current->error : SYNTAX_OK;
+        current->expectBefore = expect;
+        parseToken(current, line);
+        state->nErrors += (current->error != SYNTAX_OK) - (oldError != SYNTAX_OK);
+
+        expect = current->expectAfter;
+    }
+
+    state->changedFrom = first;
+}
+
+// Describes the most relevant problem of the line near an offset
+int describeSyntax(SyntaxState* state, const char* line, int position, char* buffer, size_t size)
+{
+    if (state->nTokens == 0)
+        return 0;
+
+    SyntaxToken* last = &state->tokens[state->nTokens - 1];
+    if (last->unterminated)
+    {
+        snprintf(buffer, size, "unbalanced quote");
+        return 1;
+    }
+
+    if (last->error == SYNTAX_OK && (last->kind == TOKEN_REDIRECTION || (last->kind == TOKEN_SEPARATOR && line[last->start] == '|')))
+    {
+        snprintf(buffer, size, "dangling '%.*s'", last->end - last->start, line + last->start);
+        return 1;
+    }
+
+    int index = syntaxTokenAt(state, position);
+    if (index == -1 || state->tokens[index].error == SYNTAX_OK)
+        return 0;
+
+    SyntaxToken* token = &state->tokens[index];
+    if (token->error == SYNTAX_UNKNOWN_COMMAND)
+        snprintf(buffer, size, "unknown command '%.*s'", token->end - token->start, line + token->start);
+    else
+        snprintf(buffer, size, "unexpected '%.*s'", token->end - token->start, line + token->start);
+
+    return 1;
+}
+
+/*-------------------------------PATH Cache----------------------------------*/
+
+/**
+ * @brief Hashes a name with 64-bit FNV-1a.
+ *
+ * @param name The name.
+ * @param length Length of the name.
+ * @return uint64_t The hash.
+ */
+static uint64_t hashName(const char* name, int length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the slot of a name, or the empty slot where it belongs.
+ *
+ * @param name The name.
+ * @param length Length of the name.
+ * @return size_t The slot index.
+ */
+static size_t findSlot(const char* name, int length)
+{
+    size_t mask = pathCache.nSlots - 1;
+    size_t slot = hashName(name, length) & mask;
+
+    while (pathCache.slots[slot])
+    {
+        const char* entry = pathCache.names + pathCache.slots[slot] - 1;
+        if (strncmp(entry, name, length) == 0 && entry[length] == '\0')
+            break;
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/**
+ * @brief Adds a name to the cache, growing the table and the name storage as needed.
+ *
+ * @param name The name.
+ * @return int 0 on success, -1 on allocation failure.
+ */
+static int addName(const char* name)
+{
+    int length = strlen(name);
+
+    if ((pathCache.nEntries + 1) * 2 > pathCache.nSlots)
+    {
+        size_t nSlots = pathCache.nSlots ? pathCache.nSlots * 2 : 1024;
+        size_t* slots = calloc(nSlots, sizeof(size_t));
+        if (!slots)
+            return -1;
+
+        size_t* oldSlots = pathCache.slots;
+        size_t oldCount = pathCache.nSlots;
+        pathCache.slots = slots;
+        pathCache.nSlots = nSlots;
+
+        for (size_t i = 0; i < oldCount; i++)
+        {
+            if (!oldSlots[i])
+                continue;
+            const char* entry = pathCache.names + oldSlots[i] - 1;
+            pathCache.slots[findSlot(entry, strlen(entry))] = oldSlots[i];
+        }
+
+        free(oldSlots);
+    }
+
+    size_t slot = findSlot(name, length);
+    if (pathCache.slots[slot])
+        return 0;  // Already found in an earlier PATH directory
+
+    if (pathCache.namesLength + length + 1 > pathCache.namesCapacity)
+    {
+        size_t capacity = pathCache.namesCapacity ? pathCache.namesCapacity * 2 : 16384;
+        while (capacity < pathCache.namesLength + length + 1)
+            capacity *= 2;
+
+        char* names = realloc(pathCache.names, capacity);
+        if (!names)
+            return -1;
+        pathCache.names = names;
+        pathCache.namesCapacity = capacity;
+    }
+
+    memcpy(pathCache.names + pathCache.namesLength, name, length + 1);
+    pathCache.slots[slot] = pathCache.namesLength + 1;
+    pathCache.namesLength += length + 1;
+    pathCache.nEntries++;
+
+    return 0;
+}
+
+/**
+ * @brief Adds the executables of a directory to the cache.
+ *
+ * @param dirPath The directory.
+ * @param mtime Where to store the directory's modification time, zeroed if it can't be read.
+ */
+static void scanDirectory(const char* dirPath, struct timespec* mtime)
+{
+    struct stat st;
+    memset(mtime, 0, sizeof(*mtime));
+
+    if (stat(dirPath, &st) == -1)
+        return;
+    *mtime = st.st_mtim;
+
+    DIR* dir = opendir(dirPath);
+    if (!dir)
+        return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.' || entry->d_type == DT_DIR)
+            continue;
+
+        if (fstatat(dirfd(dir), entry->d_name, &st, 0) == -1 || !S_ISREG(st.st_mode) || !(st.st_mode & 0111))
+            continue;
+
+        if (addName(entry->d_name) != 0)
+            break;
+    }
+
+    closedir(dir);
+}
+
+/**
+ * @brief Builds the cache from the current PATH.
+ *
+ * Relative PATH entries depend on the working directory and are left out, their commands are never reported as unknown.
+ */
+static void buildPathCache()
+{
+    const char* path = getenv("PATH");
+    pathCache.built = 1;
+    pathCache.path = strdup(path ? path : "");
+    if (!pathCache.path)
+        return;
+
+    int nDirs = 1;
+    for (const char* c = pathCache.path; *c; c++)
+        nDirs += (*c == ':');
+
+    pathCache.mtimes = calloc(nDirs, sizeof(struct timespec));
+    if (!pathCache.mtimes)
+        return;
+    pathCache.nDirs = nDirs;
+
+    char dirPath[MAX_STRING_LENGTH];
+    const char* start = pathCache.path;
+    for (int i = 0; i < nDirs; i++)
+    {
+        const char* end = strchr(start, ':');
+        int length = end ? end - start : (int)strlen(start);
+
+        if (start[0] == '/' && length < (int)sizeof(dirPath))
+        {
+            snprintf(dirPath, sizeof(dirPath), "%.*s", length, start);
+            scanDirectory(dirPath, &pathCache.mtimes[i]);
+        }
+
+        start += length + 1;
+    }
+
+    LOG_DEBUG("PATH cache built: %zu executables in %d directories\n", pathCache.nEntries, nDirs);
+}
+
+// Rebuilds the PATH cache if PATH or one of its directories changed since it was built
+void refreshPathCache()
+{
+    if (!pathCache.built)
+        return;
+
+    const char* path = getenv("PATH");
+    if (!pathCache.path || !pathCache.mtimes || strcmp(pathCache.path, path ? path : "") != 0)
+    {
+        freePathCache();
+        return;
+    }
+
+    // A command installed or removed since the last line changes its directory's modification time
+    char dirPath[MAX_STRING_LENGTH];
+    const char* start = pathCache.path;
+    for (int i = 0; i < pathCache.nDirs; i++)
+    {
+        const char* end = strchr(start, ':');
+        int length = end ? end - start : (int)strlen(start);
+
+        if (start[0] == '/' && length < (int)sizeof(dirPath))
+        {
+            struct stat st;
+            snprintf(dirPath, sizeof(dirPath), "%.*s", length, start);
+
+            int exists = stat(dirPath, &st) == 0;
+            if (exists != (pathCache.mtimes[i].tv_sec || pathCache.mtimes[i].tv_nsec) ||
+                (exists && (st.st_mtim.tv_sec != pathCache.mtimes[i].tv_sec || st.st_mtim.tv_nsec != pathCache.mtimes[i].tv_nsec)))
+            {
+                freePathCache();
+                return;
+            }
+        }
+
+        start += length + 1;
+    }
+}
+
+// Checks whether a name is a builtin or an executable found in PATH
+int commandExists(const char* name, int length)
+{
+    char buffer[MAX_STRING_LENGTH];
+    if (length <= 0 || length >= (int)sizeof(buffer))
+        return 0;
+
+    memcpy(buffer, name, length);
+    buffer[length] = '\0';
+
+    if (getExecutionFunction(buffer) != executeProcess)
+        return 1;
+
+    if (memchr(name, '/', length))
+        return access(buffer, X_OK) == 0;
+
+    if (!pathCache.built)
+        buildPathCache();
+
+    return pathCache.nSlots && pathCache.slots[findSlot(name, length)] != 0;
+}
+
+// Frees the PATH cache
+void freePathCache()
+{
+    free(pathCache.path);
+    free(pathCache.mtimes);
+    free(pathCache.names);
+    free(pathCache.slots);
+    memset(&pathCache, 0, sizeof(pathCache));
+}